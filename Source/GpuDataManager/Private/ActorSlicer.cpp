@@ -3,8 +3,19 @@
 
 #include "ActorSlicer.h"
 #include "JsonObjectConverter.h"
+#include "Hash/xxhash.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Serialization/MemoryReader.h"
+#include "WorldCollision.h"
+#include "GpuDataManagerStats.h"
 
 #define LOG_ERROR(ErrorText) UE_LOG(LogTemp, Warning, TEXT("ActorSlicer %s: %s"), *FString(__func__), *FString(ErrorText));
 
@@ -52,6 +63,8 @@ TSharedPtr<FJsonObject> FCloudPack::Deserialize(const FString& JsonString)
 
 void FCloudPack::WriteToFile(const FString& Text, const FString& FileName)
 {
+	GPUDATA_SCOPE(STAT_GpuData_Serialization, Serialization);
+	FGpuDataManagerStats::AddBytesSerialized(Text.Len() * sizeof(TCHAR));
 	if (!FFileHelper::SaveStringToFile(*Text, *FileName))
 	{
 		// Error
@@ -61,6 +74,7 @@ void FCloudPack::WriteToFile(const FString& Text, const FString& FileName)
 
 FString FCloudPack::ReadFromFile(const FString& FileName)
 {
+	GPUDATA_SCOPE(STAT_GpuData_Serialization, Serialization);
 	if (!FPlatformFileManager::Get().GetPlatformFile().FileExists(*FileName))
 	{
 		// Error
@@ -73,9 +87,150 @@ FString FCloudPack::ReadFromFile(const FString& FileName)
 		// Error
 		return {};
 	}
+	FGpuDataManagerStats::AddBytesSerialized(Result.Len() * sizeof(TCHAR));
 	return Result;
 }
 
+namespace
+{
+	const TArray<TEnumAsByte<EObjectTypeQuery>>& GetSlicerObjectTypes()
+	{
+		static const TArray<TEnumAsByte<EObjectTypeQuery>> ObjectTypes {
+			UEngineTypes::ConvertToObjectType(ECC_WorldDynamic)
+		};
+		return ObjectTypes;
+	}
+
+	// Traces go from both box sides towards the point, ends are moved out of the point on the box faces
+	void GetTraceEnds(const FVector& TestPoint, const FVector& Min, const FVector& Max, FVector& LowEndPoint, FVector& UpEndPoint)
+	{
+		LowEndPoint = { TestPoint.X, TestPoint.Y, Min.Z };
+		UpEndPoint = { TestPoint.X, TestPoint.Y, Max.Z };
+
+		if (UKismetMathLibrary::NearlyEqual_FloatFloat(TestPoint.Z, LowEndPoint.Z))
+		{
+			LowEndPoint.Z -= 1;
+		}
+		if (UKismetMathLibrary::NearlyEqual_FloatFloat(TestPoint.Z, UpEndPoint.Z))
+		{
+			UpEndPoint.Z += 1;
+		}
+	}
+
+	// Next point in FPointCloud::Points order, Z reaches Density.Z after the last point
+	void AdvanceCursor(FIntVector& Cursor, const FIntVector& Density)
+	{
+		if (++Cursor.X == Density.X)
+		{
+			Cursor.X = 0;
+			if (++Cursor.Y == Density.Y)
+			{
+				Cursor.Y = 0;
+				++Cursor.Z;
+			}
+		}
+	}
+
+	constexpr uint32 CloudPackBinaryMagic = 0x4B504C43; // "CLPK"
+	constexpr uint32 CloudPackBinaryVersion = 8;
+
+	bool ReadCloudPack(FArchive& Ar, FCloudPack& Pack)
+	{
+		uint32 Magic = 0;
+		uint32 Version = 0;
+		Ar << Magic << Version;
+		if (Magic != CloudPackBinaryMagic || Version != CloudPackBinaryVersion)
+		{
+			LOG_ERROR("Unknown cloud pack binary format");
+			return false;
+		}
+		Ar << Pack;
+		return !Ar.IsError();
+	}
+}
+
+FArchive& operator<<(FArchive& Ar, FCloudRefs& Refs)
+{
+	Ar << Refs.CloudHash;
+	Ar << Refs.SliceHashes;
+	Ar << Refs.SliceStackHashes;
+	Ar << Refs.LabeledCloudHash;
+	Ar << Refs.SliceContourHashes;
+	Ar << Refs.CompressedCloudHash;
+	Ar << Refs.GenerationKey;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FCloudPack& Pack)
+{
+	Ar << Pack.Data;
+	Ar << Pack.Clouds;
+	Ar << Pack.Slices;
+	Ar << Pack.SliceStacks;
+	Ar << Pack.LabeledClouds;
+	Ar << Pack.CompressedClouds;
+	Ar << Pack.SliceContours;
+	return Ar;
+}
+
+bool FCloudPack::WriteToBinaryFile(const FCloudPack& Pack, const FString& FileName)
+{
+	GPUDATA_SCOPE(STAT_GpuData_Serialization, Serialization);
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*FileName));
+	if (!Writer)
+	{
+		LOG_ERROR("Can't open file for writing");
+		return false;
+	}
+
+	uint32 Magic = CloudPackBinaryMagic;
+	uint32 Version = CloudPackBinaryVersion;
+	*Writer << Magic << Version;
+	// Saving archive does not modify the pack
+	*Writer << const_cast<FCloudPack&>(Pack);
+	FGpuDataManagerStats::AddBytesSerialized(Writer->Tell());
+	return Writer->Close();
+}
+
+TOptional<FCloudPack> FCloudPack::ReadFromBinaryFile(const FString& FileName)
+{
+	GPUDATA_SCOPE(STAT_GpuData_Serialization, Serialization);
+	FCloudPack Pack;
+
+	// Map the file when the platform allows it, otherwise read it as a whole. Blobs are copied out of the mapping into
+	// the pack, so the mapping saves the read buffer only: its pages are file-backed and dropped with the region
+	FOpenMappedResult MappedFile = FPlatformFileManager::Get().GetPlatformFile().OpenMappedEx(*FileName);
+	if (MappedFile.HasValue())
+	{
+		const TUniquePtr<IMappedFileHandle> Handle = MappedFile.StealValue();
+		const TUniquePtr<IMappedFileRegion> Region(Handle->MapRegion(0, Handle->GetFileSize()));
+		if (Region)
+		{
+			FMemoryReaderView Reader(TArrayView64<const uint8>(Region->GetMappedPtr(), Region->GetMappedSize()));
+			if (!ReadCloudPack(Reader, Pack))
+			{
+				return {};
+			}
+			FGpuDataManagerStats::AddBytesSerialized(Reader.Tell());
+			return Pack;
+		}
+	}
+
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *FileName, FILEREAD_Silent))
+	{
+		LOG_ERROR("Can't read cloud pack file");
+		return {};
+	}
+	FMemoryReader Reader(Bytes);
+	if (!ReadCloudPack(Reader, Pack))
+	{
+		return {};
+	}
+	FGpuDataManagerStats::AddBytesSerialized(Reader.Tell());
+	return Pack;
+}
+
 // Sets default values for this component's properties
 UActorSlicer::UActorSlicer()
 {
@@ -102,7 +257,10 @@ void UActorSlicer::TickComponent(float DeltaTime, ELevelTick TickType, FActorCom
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
-	// ...
+	if (GenerationJob)
+	{
+		TickGeneration();
+	}
 }
 
 void UActorSlicer::SetCachePointer(const TSoftObjectPtr<UCloudCache> CachePtr, const FName NewCloudCacheTag)
@@ -111,9 +269,42 @@ void UActorSlicer::SetCachePointer(const TSoftObjectPtr<UCloudCache> CachePtr, c
 	CloudCacheTag = NewCloudCacheTag;
 }
 
-int32 FPointCloud::ToPlainIndex(const FIntVector& Coord, const FIntVector& MatrixSize)
+namespace
+{
+	// Bit I of a coordinate inside a brick moved to bit 3 * I, interleaved coordinates give Morton order
+	constexpr uint32 BrickMortonSpread[1 << FPointCloud::BrickShift] = {
+		0b000000000, 0b000000001, 0b000001000, 0b000001001, 0b001000000, 0b001000001, 0b001001000, 0b001001001 };
+}
+
+int64 FPointCloud::ToPlainIndex(const FIntVector& Coord, const FIntVector& MatrixSize)
+{
+	return Coord.X + (Coord.Y + static_cast<int64>(Coord.Z) * MatrixSize.Y) * MatrixSize.X;
+}
+
+int64 FPointCloud::ToBrickIndex(const FIntVector& Coord, const FIntVector& MatrixSize)
+{
+	constexpr int32 BrickMask = (1 << BrickShift) - 1;
+	const int64 BricksX = (MatrixSize.X + BrickMask) >> BrickShift;
+	const int64 BricksY = (MatrixSize.Y + BrickMask) >> BrickShift;
+	const int64 Brick = (Coord.X >> BrickShift) + ((Coord.Y >> BrickShift) + (Coord.Z >> BrickShift) * BricksY) * BricksX;
+	const uint32 InBrick = BrickMortonSpread[Coord.X & BrickMask] | BrickMortonSpread[Coord.Y & BrickMask] << 1 |
+		BrickMortonSpread[Coord.Z & BrickMask] << 2;
+	return Brick << (3 * BrickShift) | InBrick;
+}
+
+int64 FPointCloud::ToIndex(const FIntVector& Coord) const
+{
+	return Layout == EPointCloudLayout::Bricks ? ToBrickIndex(Coord, PointDensity) : ToPlainIndex(Coord, PointDensity);
+}
+
+int64 FPointCloud::GetStorageSize() const
 {
-	return Coord.X + Coord.Y * MatrixSize.X + Coord.Z * MatrixSize.X * MatrixSize.Y;
+	if (Layout == EPointCloudLayout::Bricks)
+	{
+		const FIntVector Bricks = (PointDensity + FIntVector((1 << BrickShift) - 1)) / (1 << BrickShift);
+		return static_cast<int64>(Bricks.X) * Bricks.Y * Bricks.Z << (3 * BrickShift);
+	}
+	return GetTotalPoints();
 }
 
 bool FPointCloud::IsValid(const FIntVector& Coord) const
@@ -123,86 +314,740 @@ bool FPointCloud::IsValid(const FIntVector& Coord) const
 			Coord.Z >= 0 && Coord.Z < PointDensity.Z;
 }
 
-FSlice::FSlice(TArray<float> Data, FVector2D TargetPhysicalSize, const FIntPoint TargetResolution) :
-	PhysicalSize(std::move(TargetPhysicalSize)),
-	Resolution(TargetResolution),
-	Data(std::move(Data))
+void FPointCloud::Init(const FIntVector& Density, EPointCloudLayout InLayout)
+{
+	PointDensity = Density;
+	Layout = InLayout;
+	const int64 TotalPoints = GetStorageSize();
+	Chunks.SetNum(static_cast<int32>((TotalPoints + ChunkSize - 1) >> ChunkShift));
+	for (int32 ChunkIndex = 0; ChunkIndex < Chunks.Num(); ++ChunkIndex)
+	{
+		const int64 ChunkStart = static_cast<int64>(ChunkIndex) << ChunkShift;
+		Chunks[ChunkIndex].Points.Init(false, static_cast<int32>(FMath::Min(ChunkSize, TotalPoints - ChunkStart)));
+	}
+}
+
+void FPointCloud::Add(bool Value)
+{
+	if (Chunks.IsEmpty() || Chunks.Last().Points.Num() == ChunkSize)
+	{
+		// Only what is left of the grid, small clouds stay small
+		const int64 Remaining = FMath::Clamp(GetTotalPoints() - Num(), 1ll, ChunkSize);
+		Chunks.AddDefaulted_GetRef().Points.Reserve(static_cast<int32>(Remaining));
+	}
+	Chunks.Last().Points.Add(Value);
+}
+
+FPointCloud FPointCloud::ToLayout(EPointCloudLayout NewLayout) const
+{
+	if (NewLayout == Layout)
+	{
+		return *this;
+	}
+	FPointCloud Result;
+	Result.Init(PointDensity, NewLayout);
+	for (int32 Z = 0; Z < PointDensity.Z; ++Z)
+	{
+		for (int32 Y = 0; Y < PointDensity.Y; ++Y)
+		{
+			for (int32 X = 0; X < PointDensity.X; ++X)
+			{
+				Result.SetPoint(Result.ToIndex({ X, Y, Z }), IsInside({ X, Y, Z }));
+			}
+		}
+	}
+	return Result;
+}
+
+void FPointCloud::SetPoints(int64 Index, const bool* Values, int64 Count)
+{
+	while (Count > 0)
+	{
+		const int32 Offset = static_cast<int32>(Index & (ChunkSize - 1));
+		const int64 Length = FMath::Min(Count, ChunkSize - Offset);
+		FMemory::Memcpy(&Chunks[static_cast<int32>(Index >> ChunkShift)].Points[Offset], Values, Length * sizeof(bool));
+		Index += Length;
+		Values += Length;
+		Count -= Length;
+	}
+}
+
+FString FPointCloud::GetContentHash() const
+{
+	// Streaming hash, same as over one contiguous array
+	FXxHash64Builder Builder;
+	Builder.Update(&PointDensity, sizeof(PointDensity));
+	Builder.Update(&Layout, sizeof(Layout));
+	for (const FPointCloudChunk& Chunk : Chunks)
+	{
+		Builder.Update(Chunk.Points.GetData(), Chunk.Points.Num() * Chunk.Points.GetTypeSize());
+	}
+	return FString::Printf(TEXT("%016llx"), Builder.Finalize().Hash);
+}
+
+bool FPointCloud::operator==(const FPointCloud& Other) const
+{
+	return PointDensity == Other.PointDensity && Layout == Other.Layout && Chunks == Other.Chunks;
+}
+
+SIZE_T FPointCloud::GetAllocatedSize() const
+{
+	SIZE_T Size = Chunks.GetAllocatedSize();
+	for (const FPointCloudChunk& Chunk : Chunks)
+	{
+		Size += Chunk.Points.GetAllocatedSize();
+	}
+	return Size;
+}
+
+FArchive& operator<<(FArchive& Ar, FPointCloud& Cloud)
+{
+	Ar << Cloud.PointDensity;
+	uint8 Layout = static_cast<uint8>(Cloud.Layout);
+	Ar << Layout;
+	Cloud.Layout = static_cast<EPointCloudLayout>(FMath::Min<uint8>(Layout, static_cast<uint8>(EPointCloudLayout::Bricks)));
+
+	// bool is serialized as 4 bytes by FArchive, write the packed bytes instead
+	int64 PointsNum = Cloud.Num();
+	Ar << PointsNum;
+	if (Ar.IsLoading())
+	{
+		if (PointsNum < 0)
+		{
+			Ar.SetError();
+			return Ar;
+		}
+		Cloud.Chunks.SetNum(static_cast<int32>((PointsNum + FPointCloud::ChunkSize - 1) >> FPointCloud::ChunkShift));
+		for (int32 ChunkIndex = 0; ChunkIndex < Cloud.Chunks.Num(); ++ChunkIndex)
+		{
+			const int64 ChunkStart = static_cast<int64>(ChunkIndex) << FPointCloud::ChunkShift;
+			Cloud.Chunks[ChunkIndex].Points.SetNumUninitialized(static_cast<int32>(FMath::Min(FPointCloud::ChunkSize, PointsNum - ChunkStart)));
+		}
+	}
+	for (FPointCloudChunk& Chunk : Cloud.Chunks)
+	{
+		Ar.Serialize(Chunk.Points.GetData(), Chunk.Points.Num() * sizeof(bool));
+	}
+	return Ar;
+}
+
+FRlePointCloud FRlePointCloud::Encode(const FPointCloud& Cloud)
+{
+	if (Cloud.Layout != EPointCloudLayout::Linear)
+	{
+		// Runs follow plain index order
+		return Encode(Cloud.ToLayout(EPointCloudLayout::Linear));
+	}
+
+	FRlePointCloud Result;
+	Result.Reset(Cloud.PointDensity);
+	for (const FPointCloudChunk& Chunk : Cloud.Chunks)
+	{
+		for (const bool Point : Chunk.Points)
+		{
+			Result.Append(Point);
+		}
+	}
+	Result.Shrink();
+	return Result;
+}
+
+FPointCloud FRlePointCloud::Decode() const
+{
+	FPointCloud Cloud;
+	Cloud.Init(PointDensity);
+	// Rows may cross chunk boundaries, decode into a row buffer
+	TArray<bool> Row;
+	Row.SetNumUninitialized(PointDensity.X);
+	for (int32 Z = 0; Z < PointDensity.Z; ++Z)
+	{
+		for (int32 Y = 0; Y < PointDensity.Y; ++Y)
+		{
+			DecodeRow(Y, Z, Row.GetData());
+			Cloud.SetPoints(FPointCloud::ToPlainIndex({ 0, Y, Z }, PointDensity), Row.GetData(), Row.Num());
+		}
+	}
+	return Cloud;
+}
+
+bool FRlePointCloud::GetRowRuns(int32 Row, int32& OutBegin, int32& OutEnd) const
+{
+	if (!RowStarts.IsValidIndex(Row))
+	{
+		return false;
+	}
+	OutBegin = BlockOffsets[Row >> RowBlockShift] + RowStarts[Row];
+	OutEnd = Row + 1 < RowStarts.Num() ? BlockOffsets[(Row + 1) >> RowBlockShift] + RowStarts[Row + 1] : Runs.Num();
+	return true;
+}
+
+void FRlePointCloud::DecodeRow(int32 Y, int32 Z, bool* OutPoints) const
+{
+	int32 Begin = 0, End = 0;
+	GetRowRuns(Y + Z * PointDensity.Y, Begin, End);
+	int32 X = 0;
+	bool Value = false;
+	for (int32 Index = Begin; Index < End; ++Index)
+	{
+		const int32 Length = FMath::Min<int32>(Runs[Index], PointDensity.X - X);
+		FMemory::Memset(OutPoints + X, Value, Length);
+		X += Length;
+		Value = !Value;
+	}
+	// Empty rows and rows of a cloud still being encoded
+	FMemory::Memzero(OutPoints + X, PointDensity.X - X);
+}
+
+bool FRlePointCloud::IsInside(const FIntVector& Coord) const
+{
+	int32 Begin, End;
+	if (!GetRowRuns(Coord.Y + Coord.Z * PointDensity.Y, Begin, End))
+	{
+		return false;
+	}
+	int32 RunEnd = 0;
+	bool Value = false;
+	for (int32 Index = Begin; Index < End; ++Index)
+	{
+		RunEnd += Runs[Index];
+		if (Coord.X < RunEnd)
+		{
+			return Value;
+		}
+		Value = !Value;
+	}
+	return false;
+}
+
+void FRlePointCloud::Reset(const FIntVector& Density)
+{
+	PointDensity = Density;
+	Runs.Reset();
+	// A row has at most X + 1 runs and two split runs per MAX_uint16 points; blocks of up to 16 rows
+	const int64 MaxRowRuns = Density.X + 2 * (Density.X / MAX_uint16) + 1;
+	RowBlockShift = 4;
+	while (RowBlockShift > 0 && ((1 << RowBlockShift) - 1) * MaxRowRuns > MAX_uint16)
+	{
+		--RowBlockShift;
+	}
+	RowStarts.Reset(Density.Y * Density.Z);
+	BlockOffsets.Reset(FMath::DivideAndRoundUp(Density.Y * Density.Z, 1 << RowBlockShift));
+	RowX = 0;
+	RunValue = false;
+}
+
+void FRlePointCloud::Append(bool Value)
+{
+	if (RowX == 0)
+	{
+		if ((RowStarts.Num() & ((1 << RowBlockShift) - 1)) == 0)
+		{
+			BlockOffsets.Add(Runs.Num());
+		}
+		RowStarts.Add(static_cast<uint16>(Runs.Num() - BlockOffsets.Last()));
+		Runs.Add(0);
+		RunValue = false;
+	}
+	if (Value != RunValue)
+	{
+		Runs.Add(0);
+		RunValue = Value;
+	}
+	else if (Runs.Last() == MAX_uint16)
+	{
+		// Zero-length run of the other value continues the current one
+		Runs.Add(0);
+		Runs.Add(0);
+	}
+	++Runs.Last();
+
+	if (++RowX == PointDensity.X)
+	{
+		RowX = 0;
+		// Empty row is a single empty run, dropped as decoding zero-fills rows without runs
+		if (!RunValue && Runs.Num() - GetLastRowBegin() == 1)
+		{
+			Runs.Pop(EAllowShrinking::No);
+		}
+	}
+}
+
+void FRlePointCloud::Shrink()
+{
+	Runs.Shrink();
+	BlockOffsets.Shrink();
+	RowStarts.Shrink();
+}
+
+FString FRlePointCloud::GetContentHash() const
+{
+	FXxHash64Builder Builder;
+	Builder.Update(&PointDensity, sizeof(PointDensity));
+	Builder.Update(Runs.GetData(), Runs.Num() * Runs.GetTypeSize());
+	Builder.Update(BlockOffsets.GetData(), BlockOffsets.Num() * BlockOffsets.GetTypeSize());
+	Builder.Update(RowStarts.GetData(), RowStarts.Num() * RowStarts.GetTypeSize());
+	return FString::Printf(TEXT("%016llx"), Builder.Finalize().Hash);
+}
+
+bool FRlePointCloud::operator==(const FRlePointCloud& Other) const
+{
+	return PointDensity == Other.PointDensity && RowBlockShift == Other.RowBlockShift && Runs == Other.Runs &&
+		BlockOffsets == Other.BlockOffsets && RowStarts == Other.RowStarts;
+}
+
+FArchive& operator<<(FArchive& Ar, FRlePointCloud& Cloud)
+{
+	Ar << Cloud.PointDensity;
+	Ar << Cloud.RowBlockShift;
+	Cloud.Runs.BulkSerialize(Ar);
+	Cloud.BlockOffsets.BulkSerialize(Ar);
+	Cloud.RowStarts.BulkSerialize(Ar);
+	return Ar;
+}
+
+uint16 FLabeledPointCloud::FindLabel(const FString& LabelName) const
+{
+	const int32 Index = LabelNames.IndexOfByKey(LabelName);
+	return Index != INDEX_NONE ? static_cast<uint16>(Index + 1) : 0;
+}
+
+FPointCloud FLabeledPointCloud::ToPointCloud(uint16 Label) const
+{
+	FPointCloud Cloud;
+	Cloud.PointDensity = PointDensity;
+	for (const uint16 PointLabel : Labels)
+	{
+		Cloud.Add(Label == 0 ? PointLabel != 0 : PointLabel == Label);
+	}
+	return Cloud;
+}
+
+FString FLabeledPointCloud::GetContentHash() const
+{
+	FXxHash64Builder Builder;
+	Builder.Update(&PointDensity, sizeof(PointDensity));
+	Builder.Update(Labels.GetData(), Labels.Num() * Labels.GetTypeSize());
+	for (const FString& LabelName : LabelNames)
+	{
+		Builder.Update(*LabelName, LabelName.Len() * sizeof(TCHAR));
+	}
+	return FString::Printf(TEXT("%016llx"), Builder.Finalize().Hash);
+}
+
+bool FLabeledPointCloud::operator==(const FLabeledPointCloud& Other) const
+{
+	return PointDensity == Other.PointDensity && Labels == Other.Labels && LabelNames == Other.LabelNames;
+}
+
+FArchive& operator<<(FArchive& Ar, FLabeledPointCloud& Cloud)
+{
+	Ar << Cloud.PointDensity;
+	Cloud.Labels.BulkSerialize(Ar);
+	Ar << Cloud.LabelNames;
+	return Ar;
+}
+
+FSlice::FSlice(TArray<float> Data, FVector2D TargetPhysicalSize, const FIntPoint TargetResolution) :
+	PhysicalSize(std::move(TargetPhysicalSize)),
+	Resolution(TargetResolution),
+	Data(std::move(Data))
+{
+}
+
+FString FSlice::GetContentHash() const
+{
+	FXxHash64Builder Builder;
+	Builder.Update(&PhysicalSize, sizeof(PhysicalSize));
+	Builder.Update(&Resolution, sizeof(Resolution));
+	Builder.Update(Data.GetData(), Data.Num() * Data.GetTypeSize());
+	return FString::Printf(TEXT("%016llx"), Builder.Finalize().Hash);
+}
+
+bool FSlice::operator==(const FSlice& Other) const
+{
+	return PhysicalSize == Other.PhysicalSize && Resolution == Other.Resolution && Data == Other.Data;
+}
+
+FArchive& operator<<(FArchive& Ar, FSlice& Slice)
+{
+	Ar << Slice.PhysicalSize;
+	Ar << Slice.Resolution;
+	Slice.Data.BulkSerialize(Ar);
+	return Ar;
+}
+
+FPointCloud UActorSlicer::GeneratePointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent, FIntVector PointDensity, bool DrawDebugInfo) const
+{
+	GPUDATA_SCOPE(STAT_GpuData_GeneratePointCloud, Generation);
+
+	// Use the box bounds in world space
+	FVector Min = SlicerBoxLocation - SlicerBoxExtent;
+	FVector Max = SlicerBoxLocation + SlicerBoxExtent;
+	
+	//DrawDebugSphere(GetWorld(), Min, 50.f, 20, FColor::Yellow, true, 10, 0, 5);
+	//DrawDebugSphere(GetWorld(), Max, 50.f, 20, FColor::Red, true, 10, 0, 5);
+
+	const FVector Size = Max - Min;
+	FVector Step = Size / FVector(PointDensity);
+
+	// Chunks are allocated as points are added, nothing is reserved for the whole grid
+	FPointCloud Cloud;
+	Cloud.PointDensity = PointDensity;
+
+	int64 TruePointsCount = 0;
+
+	const TArray<TEnumAsByte<EObjectTypeQuery>>& ObjectTypes = GetSlicerObjectTypes();
+
+	for (int32 ZIndex = 0; ZIndex < PointDensity.Z; ++ZIndex)
+	{
+		for (int32 YIndex = 0; YIndex < PointDensity.Y; ++YIndex)
+		{
+			for (int32 XIndex = 0; XIndex < PointDensity.X; ++XIndex)
+			{
+				FVector TestPoint = Min + FVector(XIndex * Step.X, YIndex * Step.Y, ZIndex * Step.Z);
+				if (IsPointInside(TestPoint, Min, Max, ObjectTypes))
+				{
+					if (DrawDebugInfo)
+					{
+						DrawDebugSphere(GetWorld(), TestPoint, 1.f, 3, FColor::Green, true, 10, 0, 0.05);
+					}
+
+					// Point is in object
+					Cloud.Add(true);
+					++TruePointsCount;
+					continue;
+				}
+
+				if (DrawDebugInfo)
+				{
+					DrawDebugSphere(GetWorld(), TestPoint, 1.f, 3, FColor::White, true, 10, 0, 0.05);
+				}
+
+				// Point is under or above object
+				Cloud.Add(false);
+			}
+		}
+	}
+
+	// Two traces per point
+	FGpuDataManagerStats::AddPhysicsTraces(2 * Cloud.GetTotalPoints());
+	UE_LOG(LogTemp, Log, TEXT("Found %lld true points"), TruePointsCount);
+	return Cloud;
+}
+
+bool UActorSlicer::IsPointInside(const FVector& TestPoint, const FVector& Min, const FVector& Max,
+	const TArray<TEnumAsByte<EObjectTypeQuery>>& ObjectTypes) const
+{
+	FVector LowEndPoint;
+	FVector UpEndPoint;
+	GetTraceEnds(TestPoint, Min, Max, LowEndPoint, UpEndPoint);
+
+	FHitResult LowHit;
+	const bool LowHitFound = UKismetSystemLibrary::LineTraceSingleForObjects(GetWorld(), LowEndPoint, TestPoint, ObjectTypes, true, {}, EDrawDebugTrace::Type::None, LowHit, false, FLinearColor::Green, FLinearColor::Red, 100);
+	FHitResult UpHit;
+	const bool UpHitFound = UKismetSystemLibrary::LineTraceSingleForObjects(GetWorld(), UpEndPoint, TestPoint, ObjectTypes, true, {}, EDrawDebugTrace::Type::None, UpHit, false, FLinearColor::Green, FLinearColor::Red, 100);
+	return LowHitFound && UpHitFound;
+}
+
+bool UActorSlicer::StartPointCloudGeneration(FVector SlicerBoxLocation, FVector SlicerBoxExtent, const FIntVector PointDensity,
+	EPointCloudGenerationMode Mode)
+{
+	if (!GetWorld())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("GetWorld returned null"));
+		return false;
+	}
+	if (PointDensity.GetMin() <= 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Point density must be positive, got %s"), *PointDensity.ToString());
+		return false;
+	}
+
+	FGenerationJob& Job = GenerationJob.Emplace();
+	Job.Mode = Mode;
+	Job.Serial = ++GenerationSerial;
+	Job.Min = SlicerBoxLocation - SlicerBoxExtent;
+	Job.Max = SlicerBoxLocation + SlicerBoxExtent;
+	Job.Step = (Job.Max - Job.Min) / FVector(PointDensity);
+	Job.Cursor = FIntVector::ZeroValue;
+	// Sized up front so partial cloud can be sliced, untraced points are false
+	Job.Cloud.Init(PointDensity);
+	// Key of the scene at start, actors moved during generation make the cloud stale
+	Job.GenerationKey = CalculateGenerationKey(SlicerBoxLocation, SlicerBoxExtent, PointDensity);
+	return true;
+}
+
+void UActorSlicer::CancelPointCloudGeneration()
+{
+	GenerationJob.Reset();
+}
+
+bool UActorSlicer::IsGeneratingPointCloud() const
+{
+	return GenerationJob.IsSet();
+}
+
+float UActorSlicer::GetGenerationProgress() const
+{
+	if (!GenerationJob)
+	{
+		return 0.f;
+	}
+	const int64 PointsNum = GenerationJob->Cloud.Num();
+	return PointsNum > 0 ? static_cast<float>(static_cast<double>(GenerationJob->CompletedPoints) / PointsNum) : 1.f;
+}
+
+FPointCloud UActorSlicer::GetPartialPointCloud(bool& Success) const
+{
+	Success = GenerationJob.IsSet();
+	if (Success)
+	{
+		return GenerationJob->Cloud;
+	}
+	return {};
+}
+
+void UActorSlicer::TickGeneration()
+{
+	GPUDATA_SCOPE(STAT_GpuData_GeneratePointCloud, Generation);
+	if (!GetWorld())
+	{
+		return;
+	}
+
+	FGenerationJob& Job = *GenerationJob;
+	if (Job.Mode == EPointCloudGenerationMode::AsyncTraces)
+	{
+		SubmitAsyncTraces(Job);
+	}
+	else
+	{
+		TraceWithinBudget(Job);
+	}
+
+	if (Job.CompletedPoints == Job.Cloud.Num())
+	{
+		FinishGeneration();
+	}
+}
+
+void UActorSlicer::TraceWithinBudget(FGenerationJob& Job)
+{
+	const FIntVector Density = Job.Cloud.PointDensity;
+	const TArray<TEnumAsByte<EObjectTypeQuery>>& ObjectTypes = GetSlicerObjectTypes();
+
+	const double EndSeconds = FPlatformTime::Seconds() + GenerationBudgetMs / 1000.0;
+	int64 TracedPoints = 0;
+	while (Job.Cursor.Z < Density.Z)
+	{
+		const FVector TestPoint = Job.Min + FVector(Job.Cursor) * Job.Step;
+		if (IsPointInside(TestPoint, Job.Min, Job.Max, ObjectTypes))
+		{
+			Job.Cloud.SetPoint(FPointCloud::ToPlainIndex(Job.Cursor, Density), true);
+			++Job.TruePointsCount;
+		}
+		++Job.CompletedPoints;
+		++TracedPoints;
+		AdvanceCursor(Job.Cursor, Density);
+
+		if (FPlatformTime::Seconds() >= EndSeconds)
+		{
+			break;
+		}
+	}
+
+	// Two traces per point
+	FGpuDataManagerStats::AddPhysicsTraces(2 * TracedPoints);
+}
+
+void UActorSlicer::SubmitAsyncTraces(FGenerationJob& Job)
+{
+	UWorld* World = GetWorld();
+	const FIntVector Density = Job.Cloud.PointDensity;
+	const FCollisionObjectQueryParams ObjectParams(GetSlicerObjectTypes());
+	const FCollisionQueryParams Params(SCENE_QUERY_STAT(ActorSlicerAsyncTrace), true);
+	// Delegate is copied into every trace request
+	const FTraceDelegate Delegate = FTraceDelegate::CreateUObject(this, &UActorSlicer::OnAsyncTraceDone, Job.Serial);
+
+	int64 SubmittedPoints = 0;
+	while (Job.Cursor.Z < Density.Z && Job.PendingTraces < 2 * AsyncTraceBatchSize)
+	{
+		// Trace user data is 32 bit, it addresses the slot instead of the point
+		int32 Slot;
+		if (Job.FreePendingSlots.Num() > 0)
+		{
+			Slot = Job.FreePendingSlots.Pop(EAllowShrinking::No);
+		}
+		else
+		{
+			Slot = Job.PendingPoints.AddDefaulted();
+		}
+		Job.PendingPoints[Slot] = { FPointCloud::ToPlainIndex(Job.Cursor, Density), 0 };
+
+		const FVector TestPoint = Job.Min + FVector(Job.Cursor) * Job.Step;
+		FVector LowEndPoint;
+		FVector UpEndPoint;
+		GetTraceEnds(TestPoint, Job.Min, Job.Max, LowEndPoint, UpEndPoint);
+
+		// User data is pending slot and trace side
+		World->AsyncLineTraceByObjectType(EAsyncTraceType::Single, LowEndPoint, TestPoint, ObjectParams, Params, &Delegate, Slot * 2);
+		World->AsyncLineTraceByObjectType(EAsyncTraceType::Single, UpEndPoint, TestPoint, ObjectParams, Params, &Delegate, Slot * 2 + 1);
+		Job.PendingTraces += 2;
+		++SubmittedPoints;
+		AdvanceCursor(Job.Cursor, Density);
+	}
+
+	FGpuDataManagerStats::AddPhysicsTraces(2 * SubmittedPoints);
+}
+
+void UActorSlicer::OnAsyncTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum, uint32 JobSerial)
+{
+	if (!GenerationJob || GenerationJob->Serial != JobSerial)
+	{
+		// Trace of a cancelled or replaced generation
+		return;
+	}
+
+	FGenerationJob& Job = *GenerationJob;
+	--Job.PendingTraces;
+	const int32 Slot = Datum.UserData / 2;
+	const uint8 SideBit = 1 << (Datum.UserData % 2);
+	FPendingPoint& Pending = Job.PendingPoints[Slot];
+	Pending.TraceMask |= SideBit << 2;
+	if (Datum.OutHits.Num() > 0)
+	{
+		Pending.TraceMask |= SideBit;
+	}
+
+	if ((Pending.TraceMask & 0b1100) != 0b1100)
+	{
+		return;
+	}
+	++Job.CompletedPoints;
+	if ((Pending.TraceMask & 0b0011) == 0b0011)
+	{
+		// Point is in object
+		Job.Cloud.SetPoint(Pending.PointIndex, true);
+		++Job.TruePointsCount;
+	}
+	Job.FreePendingSlots.Add(Slot);
+}
+
+void UActorSlicer::FinishGeneration()
 {
+	UE_LOG(LogTemp, Log, TEXT("Found %lld true points"), GenerationJob->TruePointsCount);
+	FGenerationJob FinishedJob = MoveTemp(*GenerationJob);
+	GenerationJob.Reset();
+	if (!Cache)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Cache will not be used, reason: cache pointer is not set"));
+	}
+	else
+	{
+		CommitCloud(MoveTemp(FinishedJob.Cloud), FinishedJob.GenerationKey);
+	}
+	OnPointCloudGenerated.Broadcast(CloudCacheTag);
 }
 
-FPointCloud UActorSlicer::GeneratePointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent, FIntVector PointDensity, bool DrawDebugInfo) const
+FLabeledPointCloud UActorSlicer::TraceLabeledPointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent,
+	FIntVector PointDensity, EVoxelLabelSource LabelSource) const
 {
-	// Use the box bounds in world space
-	FVector Min = SlicerBoxLocation - SlicerBoxExtent;
-	FVector Max = SlicerBoxLocation + SlicerBoxExtent;
-	
-	//DrawDebugSphere(GetWorld(), Min, 50.f, 20, FColor::Yellow, true, 10, 0, 5);
-	//DrawDebugSphere(GetWorld(), Max, 50.f, 20, FColor::Red, true, 10, 0, 5);
+	GPUDATA_SCOPE(STAT_GpuData_GeneratePointCloud, Generation);
 
-	const FVector Size = Max - Min;
-	FVector Step = Size / FVector(PointDensity);
+	const FVector Min = SlicerBoxLocation - SlicerBoxExtent;
+	const FVector Max = SlicerBoxLocation + SlicerBoxExtent;
+	const FVector Step = (Max - Min) / FVector(PointDensity);
+	const TArray<TEnumAsByte<EObjectTypeQuery>>& ObjectTypes = GetSlicerObjectTypes();
 
-	FPointCloud Cloud;
+	FLabeledPointCloud Cloud;
+	const int64 TotalPoints = static_cast<int64>(PointDensity.X) * PointDensity.Y * PointDensity.Z;
+	if (TotalPoints > MAX_int32)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Labeled cloud of %lld points is too large, max is %d"), TotalPoints, MAX_int32);
+		return Cloud;
+	}
 	Cloud.PointDensity = PointDensity;
-	Cloud.Points.Reserve(PointDensity.X * PointDensity.Y * PointDensity.Z);
+	Cloud.Labels.Reserve(static_cast<int32>(TotalPoints));
+	TMap<FString, uint16> LabelsByName;
 
-	int TruePointsCount = 0;
+	auto GetLabelName = [LabelSource](const FHitResult& Hit) -> FString
+	{
+		if (LabelSource == EVoxelLabelSource::PhysicalMaterial)
+		{
+			return Hit.PhysMaterial.IsValid() ? Hit.PhysMaterial->GetName() : TEXT("Default");
+		}
+		return Hit.GetActor() ? Hit.GetActor()->GetName() : FString();
+	};
 
+	int32 TruePointsCount = 0;
 	for (int32 ZIndex = 0; ZIndex < PointDensity.Z; ++ZIndex)
 	{
 		for (int32 YIndex = 0; YIndex < PointDensity.Y; ++YIndex)
 		{
 			for (int32 XIndex = 0; XIndex < PointDensity.X; ++XIndex)
 			{
-				FVector TestPoint = Min + FVector(XIndex * Step.X, YIndex * Step.Y, ZIndex * Step.Z);
-				FVector LowEndPoint { TestPoint.X, TestPoint.Y, Min.Z };
-				FVector UpEndPoint { TestPoint.X, TestPoint.Y, Max.Z };
+				const FVector TestPoint = Min + FVector(XIndex * Step.X, YIndex * Step.Y, ZIndex * Step.Z);
+				FVector LowEndPoint;
+				FVector UpEndPoint;
+				GetTraceEnds(TestPoint, Min, Max, LowEndPoint, UpEndPoint);
 
-				if (UKismetMathLibrary::NearlyEqual_FloatFloat(TestPoint.Z, LowEndPoint.Z))
-				{
-					LowEndPoint.Z -= 1;
-				}
-				if (UKismetMathLibrary::NearlyEqual_FloatFloat(TestPoint.Z, UpEndPoint.Z))
-				{
-					UpEndPoint.Z += 1;
-				}
+				// Last hits are the surfaces nearest to the point, the point is inside an actor when both belong to it
+				TArray<FHitResult> LowHits;
+				TArray<FHitResult> UpHits;
+				UKismetSystemLibrary::LineTraceMultiForObjects(GetWorld(), LowEndPoint, TestPoint, ObjectTypes, true, {}, EDrawDebugTrace::Type::None, LowHits, false);
+				UKismetSystemLibrary::LineTraceMultiForObjects(GetWorld(), UpEndPoint, TestPoint, ObjectTypes, true, {}, EDrawDebugTrace::Type::None, UpHits, false);
 
-				TArray<TEnumAsByte<EObjectTypeQuery>> ObjectTypes {
-					UEngineTypes::ConvertToObjectType(ECC_WorldDynamic)
-				};
-
-				FHitResult LowHit;
-				const bool LowHitFound = UKismetSystemLibrary::LineTraceSingleForObjects(GetWorld(), LowEndPoint, TestPoint, ObjectTypes, true, {}, EDrawDebugTrace::Type::None, LowHit, false, FLinearColor::Green, FLinearColor::Red, 100);
-				FHitResult UpHit;
-				const bool UpHitFound = UKismetSystemLibrary::LineTraceSingleForObjects(GetWorld(), UpEndPoint, TestPoint, ObjectTypes, true, {}, EDrawDebugTrace::Type::None, UpHit, false, FLinearColor::Green, FLinearColor::Red, 100);
-				if (LowHitFound && UpHitFound)
+				uint16 Label = 0;
+				if (LowHits.Num() > 0 && UpHits.Num() > 0 && LowHits.Last().GetActor() == UpHits.Last().GetActor())
 				{
-					if (DrawDebugInfo)
+					const FString LabelName = GetLabelName(LowHits.Last());
+					if (const uint16* Existing = LabelsByName.Find(LabelName))
 					{
-						DrawDebugSphere(GetWorld(), TestPoint, 1.f, 3, FColor::Green, true, 10, 0, 0.05);
+						Label = *Existing;
 					}
-
-					// Point is in object
-					Cloud.Points.Add(true);
-					++TruePointsCount;
-					continue;
-				}
-
-				if (DrawDebugInfo)
-				{
-					DrawDebugSphere(GetWorld(), TestPoint, 1.f, 3, FColor::White, true, 10, 0, 0.05);
+					else if (Cloud.LabelNames.Num() < TNumericLimits<uint16>::Max())
+					{
+						Label = static_cast<uint16>(Cloud.LabelNames.Add(LabelName) + 1);
+						LabelsByName.Add(LabelName, Label);
+					}
+					else
+					{
+						UE_LOG(LogTemp, Warning, TEXT("Too many labels, %s is left empty"), *LabelName);
+					}
+					TruePointsCount += Label != 0;
 				}
-
-				// Point is under or above object
-				Cloud.Points.Add(false);
+				Cloud.Labels.Add(Label);
 			}
 		}
 	}
 
-	UE_LOG(LogTemp, Log, TEXT("Found %d true points"), TruePointsCount);
+	// Two traces per point
+	FGpuDataManagerStats::AddPhysicsTraces(2ll * PointDensity.X * PointDensity.Y * PointDensity.Z);
+	UE_LOG(LogTemp, Log, TEXT("Found %d true points with %d labels"), TruePointsCount, Cloud.LabelNames.Num());
 	return Cloud;
 }
 
+void UActorSlicer::GenerateLabeledPointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent,
+	const FIntVector PointDensity, EVoxelLabelSource LabelSource)
+{
+	if (!GetWorld())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("GetWorld returned null"));
+		return;
+	}
+
+	FLabeledPointCloud Cloud = TraceLabeledPointCloud(SlicerBoxLocation, SlicerBoxExtent, PointDensity, LabelSource);
+	if (!Cache)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Cache will not be used, reason: cache pointer is not set"));
+		return;
+	}
+
+	// Plain cloud keeps CalculateSliceOnPlane and generation key checks working for the tag
+	CommitCloud(Cloud.ToPointCloud(), CalculateGenerationKey(SlicerBoxLocation, SlicerBoxExtent, PointDensity));
+	Cache->SetLabeledCloud(CloudCacheTag, MoveTemp(Cloud));
+}
+
 void UActorSlicer::GeneratePointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent, const FIntVector PointDensity)
 {
 	if (!GetWorld())
@@ -211,14 +1056,74 @@ void UActorSlicer::GeneratePointCloud(FVector SlicerBoxLocation, FVector SlicerB
 		return;
 	}
 
-	const auto Cloud = GeneratePointCloud(SlicerBoxLocation, SlicerBoxExtent, PointDensity, false);
+	if (bCompressClouds)
+	{
+		// Runs are emitted while tracing, the expanded cloud never exists
+		auto CompressedCloud = TraceCompressedPointCloud(SlicerBoxLocation, SlicerBoxExtent, PointDensity);
+		if (!Cache)
+		{
+			UE_LOG(LogTemp, Log, TEXT("Cache will not be used, reason: cache pointer is not set"));
+			return;
+		}
+		Cache->SetCompressedCloudValueWithKey(CloudCacheTag, std::move(CompressedCloud), CalculateGenerationKey(SlicerBoxLocation, SlicerBoxExtent, PointDensity));
+		return;
+	}
+
+	auto Cloud = GeneratePointCloud(SlicerBoxLocation, SlicerBoxExtent, PointDensity, false);
 	if (!Cache)
 	{
 		UE_LOG(LogTemp, Log, TEXT("Cache will not be used, reason: cache pointer is not set"));
 		return;
 	}
 	
-	Cache->SetCloudValue(CloudCacheTag, Cloud);
+	CommitCloud(MoveTemp(Cloud), CalculateGenerationKey(SlicerBoxLocation, SlicerBoxExtent, PointDensity));
+}
+
+FRlePointCloud UActorSlicer::TraceCompressedPointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent,
+	FIntVector PointDensity) const
+{
+	GPUDATA_SCOPE(STAT_GpuData_GeneratePointCloud, Generation);
+
+	const FVector Min = SlicerBoxLocation - SlicerBoxExtent;
+	const FVector Max = SlicerBoxLocation + SlicerBoxExtent;
+	const FVector Step = (Max - Min) / FVector(PointDensity);
+	const TArray<TEnumAsByte<EObjectTypeQuery>>& ObjectTypes = GetSlicerObjectTypes();
+
+	FRlePointCloud Cloud;
+	Cloud.Reset(PointDensity);
+	for (int32 ZIndex = 0; ZIndex < PointDensity.Z; ++ZIndex)
+	{
+		for (int32 YIndex = 0; YIndex < PointDensity.Y; ++YIndex)
+		{
+			for (int32 XIndex = 0; XIndex < PointDensity.X; ++XIndex)
+			{
+				const FVector TestPoint = Min + FVector(XIndex * Step.X, YIndex * Step.Y, ZIndex * Step.Z);
+				Cloud.Append(IsPointInside(TestPoint, Min, Max, ObjectTypes));
+			}
+		}
+	}
+	Cloud.Shrink();
+
+	// Two traces per point
+	FGpuDataManagerStats::AddPhysicsTraces(2ll * PointDensity.X * PointDensity.Y * PointDensity.Z);
+	UE_LOG(LogTemp, Log, TEXT("Encoded %lld points into %d runs"), static_cast<int64>(PointDensity.X) * PointDensity.Y * PointDensity.Z, Cloud.Runs.Num());
+	return Cloud;
+}
+
+void UActorSlicer::CommitCloud(FPointCloud Cloud, const FString& GenerationKey)
+{
+	if (bCompressClouds)
+	{
+		Cache->SetCompressedCloudValueWithKey(CloudCacheTag, FRlePointCloud::Encode(Cloud), GenerationKey);
+	}
+	else if (CloudLayout != Cloud.Layout)
+	{
+		Cache->SetCloudValueWithKey(CloudCacheTag, Cloud.ToLayout(CloudLayout), GenerationKey);
+	}
+	else
+	{
+		Cache->SetCloudValueWithKey(CloudCacheTag, MoveTemp(Cloud), GenerationKey);
+	}
 }
 
 void UActorSlicer::GenerateOrLoadPointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent,
@@ -227,17 +1132,82 @@ void UActorSlicer::GenerateOrLoadPointCloud(FVector SlicerBoxLocation, FVector S
 	if (Cache.IsValid())
 	{
 		bool Success;
-		Cache->GetCloud(CloudCacheTag, Success);
-		if (Success)
+		const FString CachedKey = Cache->GetCloudGenerationKey(CloudCacheTag, Success);
+		if (Success && CachedKey == CalculateGenerationKey(SlicerBoxLocation, SlicerBoxExtent, PointDensity))
 		{
 			UE_LOG(LogTemp, Log, TEXT("Found cloud in cache, skip generation"))
 			return;
 		}
+		if (Success)
+		{
+			UE_LOG(LogTemp, Log, TEXT("Cached cloud %s is stale, regenerate"), *CloudCacheTag.ToString());
+		}
 	}
 
 	GeneratePointCloud(SlicerBoxLocation, SlicerBoxExtent, PointDensity);
 }
 
+FString UActorSlicer::CalculateGenerationKey(FVector SlicerBoxLocation, FVector SlicerBoxExtent,
+	const FIntVector PointDensity) const
+{
+	FXxHash64Builder Builder;
+	Builder.Update(&SlicerBoxLocation, sizeof(SlicerBoxLocation));
+	Builder.Update(&SlicerBoxExtent, sizeof(SlicerBoxExtent));
+	Builder.Update(&PointDensity, sizeof(PointDensity));
+
+	TArray<AActor*> OverlappingActors;
+	if (GetWorld())
+	{
+		UKismetSystemLibrary::BoxOverlapActors(GetWorld(), SlicerBoxLocation, SlicerBoxExtent, GetSlicerObjectTypes(), nullptr, {}, OverlappingActors);
+	}
+
+	auto HashTransform = [](FXxHash64Builder& ActorBuilder, const FTransform& Transform)
+	{
+		const FVector Location = Transform.GetLocation();
+		const FQuat Rotation = Transform.GetRotation();
+		const FVector Scale = Transform.GetScale3D();
+		ActorBuilder.Update(&Location, sizeof(Location));
+		ActorBuilder.Update(&Rotation, sizeof(Rotation));
+		ActorBuilder.Update(&Scale, sizeof(Scale));
+	};
+	auto HashString = [](FXxHash64Builder& ActorBuilder, const FString& String)
+	{
+		ActorBuilder.Update(*String, String.Len() * sizeof(TCHAR));
+	};
+
+	// Actors are identified by name, transform and meshes only: path names carry the PIE prefix and the world
+	// package, so a cloud baked in the editor would not match in PIE or a cooked build. Each actor is hashed on its
+	// own and the sorted hashes are combined, as overlap order is not stable between runs
+	TArray<uint64> ActorHashes;
+	ActorHashes.Reserve(OverlappingActors.Num());
+	for (const AActor* Actor : OverlappingActors)
+	{
+		FXxHash64Builder ActorBuilder;
+		HashString(ActorBuilder, Actor->GetFName().ToString());
+		HashTransform(ActorBuilder, Actor->GetActorTransform());
+
+		TInlineComponentArray<UPrimitiveComponent*> Primitives(Actor);
+		for (const UPrimitiveComponent* Primitive : Primitives)
+		{
+			if (!Primitive->IsCollisionEnabled())
+			{
+				continue;
+			}
+			HashTransform(ActorBuilder, Primitive->GetComponentTransform());
+
+			// Asset and class paths don't depend on the world
+			const UStaticMeshComponent* MeshComponent = Cast<UStaticMeshComponent>(Primitive);
+			const UStaticMesh* Mesh = MeshComponent ? MeshComponent->GetStaticMesh() : nullptr;
+			HashString(ActorBuilder, Mesh ? Mesh->GetPathName() : Primitive->GetClass()->GetPathName());
+		}
+		ActorHashes.Add(ActorBuilder.Finalize().Hash);
+	}
+	ActorHashes.Sort();
+	Builder.Update(ActorHashes.GetData(), ActorHashes.Num() * ActorHashes.GetTypeSize());
+
+	return FString::Printf(TEXT("%016llx"), Builder.Finalize().Hash);
+}
+
 bool UActorSlicer::IsCacheSet() const
 {
 	return !Cache.IsNull();
@@ -273,8 +1243,8 @@ void UActorSlicer::DrawPointCloudFromCache(FVector SlicerBoxLocation, FVector Sl
 				FVector TestPoint = Min + FVector(XIndex * Step.X, YIndex * Step.Y, ZIndex * Step.Z);
 
 				FColor DebugColor;
-				const int32 Index = FPointCloud::ToPlainIndex({XIndex, YIndex, ZIndex}, CachedCloud.PointDensity);
-				if (CachedCloud.IsValid({XIndex, YIndex, ZIndex}) && CachedCloud.Points[Index])
+				const int64 Index = CachedCloud.ToIndex({XIndex, YIndex, ZIndex});
+				if (CachedCloud.IsValid({XIndex, YIndex, ZIndex}) && Index < CachedCloud.Num() && CachedCloud.GetPoint(Index))
 				{
 					DebugColor = FColor::Green;
 				}
@@ -308,6 +1278,116 @@ struct FRectangleGrid
 		return Min + PlaneXAxis * XAlpha + PlaneYAxis * YAlpha;
 	}
 };
+
+namespace
+{
+	// Calls PixelFunction(PixelIndex, CloudCoords) with the closest cloud point of every slice pixel
+	template <typename FPixelFunction>
+	void ForEachSlicePixel(const FVector& PlaneOrigin, const FRotator& PlaneRotation, const FVector& PointCloudExtent,
+		const FVector& PointCloudOrigin, const FVector2D& ImagePhysicalSize, const FIntPoint& TargetImageSize,
+		const FIntVector& Density, FPixelFunction PixelFunction)
+	{
+		// Calculate slicer data
+		FRotationMatrix PlaneRotator(PlaneRotation);
+		FVector PlaneNormal = PlaneRotator.GetUnitAxis(EAxis::Z);
+		const FVector XAxis = PlaneRotator.GetUnitAxis(EAxis::X); // Right
+		const FVector YAxis = PlaneRotator.GetUnitAxis(EAxis::Y); // Up
+		FPlane Plane(PlaneOrigin, PlaneNormal);
+
+		FVector ProjectionCenter = PointCloudOrigin - Plane.PlaneDot(PointCloudOrigin) * PlaneNormal;
+		FVector TopLeft = ProjectionCenter - XAxis * ImagePhysicalSize.X / 2 + YAxis * ImagePhysicalSize.Y / 2;
+		FVector TopRight = ProjectionCenter + XAxis * ImagePhysicalSize.X / 2 + YAxis * ImagePhysicalSize.Y / 2;
+		FVector BottomLeft = ProjectionCenter - XAxis * ImagePhysicalSize.X / 2 - YAxis * ImagePhysicalSize.Y / 2;
+		FVector BottomRight = ProjectionCenter + XAxis * ImagePhysicalSize.X / 2 - YAxis * ImagePhysicalSize.Y / 2;
+		
+		FRectangleGrid ProjectionCanvas {
+		.Min = BottomLeft,
+		.Max = TopRight,
+		.XPoint = BottomRight,
+		.YPoint = TopLeft,
+		.TargetPointsNumber = { TargetImageSize.X, TargetImageSize.Y } };
+
+		// Calculate cloud data
+		FVector Min = PointCloudOrigin - PointCloudExtent;
+		FVector Max = PointCloudOrigin + PointCloudExtent;
+		
+		const FVector3d Step = (Max - Min) / FVector3d(Density);
+		
+		for (int32 YIndex = 0; YIndex < TargetImageSize.Y; ++YIndex)
+		{
+			for (int32 XIndex = 0; XIndex < TargetImageSize.X; ++XIndex)
+			{
+				// Calculate closest cloud point
+				FVector RealTargetCoords = ProjectionCanvas.GetPoint({XIndex, YIndex});
+
+				FIntVector LocalCloudCoords = FIntVector((RealTargetCoords - Min) / Step);
+				LocalCloudCoords.X = UKismetMathLibrary::Clamp(LocalCloudCoords.X, 0, Density.X - 1);
+				LocalCloudCoords.Y = UKismetMathLibrary::Clamp(LocalCloudCoords.Y, 0, Density.Y - 1);
+				LocalCloudCoords.Z = UKismetMathLibrary::Clamp(LocalCloudCoords.Z, 0, Density.Z - 1);
+
+				PixelFunction(YIndex * TargetImageSize.X + XIndex, LocalCloudCoords);
+			}
+		}
+	}
+
+	// Average of IsInside over the point and its 7 neighbours towards +X/+Y/+Z, scaled to 0..256
+	template <typename FIsInside>
+	float AverageNeighbours(const FIntVector& CloudCoords, const FIntVector& Density, FIsInside IsInside)
+	{
+		auto GetValue = [&](const FIntVector &Coords) -> unsigned int
+		{
+			if (Coords.X >= Density.X || Coords.Y >= Density.Y || Coords.Z >= Density.Z)
+			{
+				return 0;
+			}
+			return IsInside(Coords) ? 1 : 0;
+		};
+		unsigned int ValueAccumulator = GetValue(CloudCoords);
+		ValueAccumulator += GetValue({CloudCoords.X + 1, CloudCoords.Y, CloudCoords.Z});
+		ValueAccumulator += GetValue({CloudCoords.X, CloudCoords.Y + 1, CloudCoords.Z});
+		ValueAccumulator += GetValue({CloudCoords.X, CloudCoords.Y, CloudCoords.Z + 1});
+		ValueAccumulator += GetValue({CloudCoords.X + 1, CloudCoords.Y + 1, CloudCoords.Z});
+		ValueAccumulator += GetValue({CloudCoords.X, CloudCoords.Y + 1, CloudCoords.Z + 1});
+		ValueAccumulator += GetValue({CloudCoords.X + 1, CloudCoords.Y, CloudCoords.Z + 1});
+		ValueAccumulator += GetValue({CloudCoords.X + 1, CloudCoords.Y + 1, CloudCoords.Z + 1});
+
+		return 256.f / 8.f * static_cast<float>(ValueAccumulator);
+	}
+
+	// Decoded rows of a compressed cloud, slot is picked by low bits of Y and Z so the 4 rows
+	// around a sample and rows of nearby pixels do not evict each other
+	class FRleRowCache
+	{
+	public:
+		explicit FRleRowCache(const FRlePointCloud& InCloud)
+			: Cloud(InCloud)
+		{
+			Rows.SetNumUninitialized(SlotsPerAxis * SlotsPerAxis * Cloud.PointDensity.X);
+			RowKeys.Init(INDEX_NONE, SlotsPerAxis * SlotsPerAxis);
+		}
+
+		bool IsInside(const FIntVector& Coord)
+		{
+			const int32 Slot = (Coord.Y & (SlotsPerAxis - 1)) | (Coord.Z & (SlotsPerAxis - 1)) * SlotsPerAxis;
+			const int32 Row = Coord.Y + Coord.Z * Cloud.PointDensity.Y;
+			bool* Points = &Rows[Slot * Cloud.PointDensity.X];
+			if (RowKeys[Slot] != Row)
+			{
+				Cloud.DecodeRow(Coord.Y, Coord.Z, Points);
+				RowKeys[Slot] = Row;
+			}
+			return Points[Coord.X];
+		}
+
+	private:
+		static constexpr int32 SlotsPerAxis = 16;
+
+		const FRlePointCloud& Cloud;
+		TArray<bool> Rows;
+		TArray<int32> RowKeys;
+	};
+}
+
 FSlice UActorSlicer::CalculateSliceOnPlane(const FVector& PlaneOrigin,
 		const FRotator& PlaneRotation,
 		const FVector& PointCloudExtent,
@@ -316,14 +1396,43 @@ FSlice UActorSlicer::CalculateSliceOnPlane(const FVector& PlaneOrigin,
 		const FVector2D& ImagePhysicalSize,
 		const FIntPoint& TargetImageSize) const
 {
+	GPUDATA_SCOPE(STAT_GpuData_CalculateSlice, Slicing);
+
 	if (Cache.IsNull())
 	{
 		UE_LOG(LogTemp, Error, TEXT("Point cloud is not cached!"));
 		return {};
 	}
-	bool IsCloudCached;
-	auto CachedCloud = Cache->GetCloud(CloudCacheTag, IsCloudCached);
-	if (!IsCloudCached) {
+
+	// Compressed cloud is decoded only in the rows the plane crosses; only the lookup serving the slice is counted
+	if (Cache->HasCompressedCloud(CloudCacheTag))
+	{
+		const FRlePointCloud* CompressedCloud = Cache->FindCompressedCloud(CloudCacheTag);
+		if (!CompressedCloud)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Point cloud is not cached!"));
+			return {};
+		}
+
+		TArray<float> Output;
+		Output.SetNumZeroed(TargetImageSize.X * TargetImageSize.Y);
+
+		FRleRowCache RowCache(*CompressedCloud);
+		const FIntVector& Density = CompressedCloud->PointDensity;
+		ForEachSlicePixel(PlaneOrigin, PlaneRotation, PointCloudExtent, PointCloudOrigin, ImagePhysicalSize, TargetImageSize,
+			Density, [&](int32 PixelIndex, const FIntVector& LocalCloudCoords)
+		{
+			Output[PixelIndex] = AverageNeighbours(LocalCloudCoords, Density, [&RowCache](const FIntVector& Coords)
+			{
+				return RowCache.IsInside(Coords);
+			});
+		});
+		return FSlice(MoveTemp(Output), ImagePhysicalSize, TargetImageSize);
+	}
+
+	// Sliced in place, the cloud is not copied out of the cache
+	const FPointCloud* CachedCloud = Cache->FindCloud(CloudCacheTag);
+	if (!CachedCloud) {
 		UE_LOG(LogTemp, Error, TEXT("Point cloud is not cached!"));
 		return {};
 	}
@@ -331,93 +1440,109 @@ FSlice UActorSlicer::CalculateSliceOnPlane(const FVector& PlaneOrigin,
 	TArray<float> Output;
 	Output.SetNumZeroed(TargetImageSize.X * TargetImageSize.Y);
 
-	// Calculate slicer data
-	FRotationMatrix PlaneRotator(PlaneRotation);
-	FVector PlaneNormal = PlaneRotator.GetUnitAxis(EAxis::Z);
-	const FVector XAxis = PlaneRotator.GetUnitAxis(EAxis::X); // Right
-	const FVector YAxis = PlaneRotator.GetUnitAxis(EAxis::Y); // Up
-	FPlane Plane(PlaneOrigin, PlaneNormal);
-
-	FVector ProjectionCenter = PointCloudOrigin - Plane.PlaneDot(PointCloudOrigin) * PlaneNormal;
-	FVector TopLeft = ProjectionCenter - XAxis * ImagePhysicalSize.X / 2 + YAxis * ImagePhysicalSize.Y / 2;
-	FVector TopRight = ProjectionCenter + XAxis * ImagePhysicalSize.X / 2 + YAxis * ImagePhysicalSize.Y / 2;
-	FVector BottomLeft = ProjectionCenter - XAxis * ImagePhysicalSize.X / 2 - YAxis * ImagePhysicalSize.Y / 2;
-	FVector BottomRight = ProjectionCenter + XAxis * ImagePhysicalSize.X / 2 - YAxis * ImagePhysicalSize.Y / 2;
-	
-	FRectangleGrid ProjectionCanvas {
-	.Min = BottomLeft,
-	.Max = TopRight,
-	.XPoint = BottomRight,
-	.YPoint = TopLeft,
-	.TargetPointsNumber = { TargetImageSize.X, TargetImageSize.Y } };
-
-	// DrawDebugSphere(GetWorld(), TopLeft, 1.f, 3, FColor::Blue, true, 10, 0, 0.05);
-	// DrawDebugSphere(GetWorld(), TopRight, 1.f, 3, FColor::Blue, true, 10, 0, 0.05);
-	// DrawDebugSphere(GetWorld(), BottomLeft, 1.f, 3, FColor::Emerald, true, 10, 0, 0.05);
-	// DrawDebugSphere(GetWorld(), BottomRight, 1.f, 3, FColor::Black, true, 10, 0, 0.05);
-
-	// Calculate cloud data
-	FVector Min = PointCloudOrigin - PointCloudExtent;
-	FVector Max = PointCloudOrigin + PointCloudExtent;
-	
-	const FIntVector3& Density = CachedCloud.PointDensity;
-	const FVector3d Step = (Max - Min) / FVector3d(Density);
-	
-	for (int32 YIndex = 0; YIndex < TargetImageSize.Y; ++YIndex)
+	const FIntVector3& Density = CachedCloud->PointDensity;
+	auto SliceWithIndex = [&](auto ToIndex)
 	{
-		for (int32 XIndex = 0; XIndex < TargetImageSize.X; ++XIndex)
+		ForEachSlicePixel(PlaneOrigin, PlaneRotation, PointCloudExtent, PointCloudOrigin, ImagePhysicalSize, TargetImageSize,
+			Density, [&](int32 PixelIndex, const FIntVector& LocalCloudCoords)
 		{
-			// Calculate closest cloud point
-			FVector RealTargetCoords = ProjectionCanvas.GetPoint({XIndex, YIndex});
-			//DrawDebugSphere(GetWorld(), RealTargetCoords, 2.f, 3, FColor::Blue, true, 10, 0, 0.05);
-
-			FIntVector LocalCloudCoords = FIntVector((RealTargetCoords - Min) / Step);
-			LocalCloudCoords.X = UKismetMathLibrary::Clamp(LocalCloudCoords.X, 0, Density.X - 1);
-			LocalCloudCoords.Y = UKismetMathLibrary::Clamp(LocalCloudCoords.Y, 0, Density.Y - 1);
-			LocalCloudCoords.Z = UKismetMathLibrary::Clamp(LocalCloudCoords.Z, 0, Density.Z - 1);
-
-			// Calculate average cloud value
-			auto GetValue = [&](const FIntVector &CloudCoords) -> float
-			{
-				if (!CachedCloud.IsValid(CloudCoords))
-				{
-					return 0.f;
-				}
-				return CachedCloud.Points[CachedCloud.ToPlainIndex(CloudCoords, Density)];
-			};
-			unsigned int ValueAccumulator = GetValue(LocalCloudCoords);
-			ValueAccumulator += GetValue({LocalCloudCoords.X + 1, LocalCloudCoords.Y, LocalCloudCoords.Z});
-			ValueAccumulator += GetValue({LocalCloudCoords.X, LocalCloudCoords.Y + 1, LocalCloudCoords.Z});
-			ValueAccumulator += GetValue({LocalCloudCoords.X, LocalCloudCoords.Y, LocalCloudCoords.Z + 1});
-			ValueAccumulator += GetValue({LocalCloudCoords.X + 1, LocalCloudCoords.Y + 1, LocalCloudCoords.Z});
-			ValueAccumulator += GetValue({LocalCloudCoords.X, LocalCloudCoords.Y + 1, LocalCloudCoords.Z + 1});
-			ValueAccumulator += GetValue({LocalCloudCoords.X + 1, LocalCloudCoords.Y, LocalCloudCoords.Z + 1});
-			ValueAccumulator += GetValue({LocalCloudCoords.X + 1, LocalCloudCoords.Y + 1, LocalCloudCoords.Z + 1});
-
-			const float AverageValue = 256.f / 8.f * static_cast<float>(ValueAccumulator);
-			
 			// Write Pixel
-			Output[YIndex * TargetImageSize.Y + XIndex] = AverageValue;
-		}
+			Output[PixelIndex] = AverageNeighbours(LocalCloudCoords, Density, [&](const FIntVector& Coords)
+			{
+				return CachedCloud->GetPoint(ToIndex(Coords, Density));
+			});
+		});
+	};
+	// Layout is resolved once per slice, every layout gets its own inlined kernel
+	if (CachedCloud->Layout == EPointCloudLayout::Bricks)
+	{
+		SliceWithIndex([](const FIntVector& Coords, const FIntVector& Size) { return FPointCloud::ToBrickIndex(Coords, Size); });
+	}
+	else
+	{
+		SliceWithIndex([](const FIntVector& Coords, const FIntVector& Size) { return FPointCloud::ToPlainIndex(Coords, Size); });
 	}
 
 	FSlice Slice(Output, ImagePhysicalSize, TargetImageSize);
 	return Slice;
 }
 
+FSlice UActorSlicer::CalculateLabeledSliceOnPlane(const FVector& PlaneOrigin, const FRotator& PlaneRotation,
+	const FVector& PointCloudExtent, const FRotator& PointCloudRotation, const FVector& PointCloudOrigin,
+	const FVector2D& ImagePhysicalSize, const FIntPoint& TargetImageSize, const FString& LabelName) const
+{
+	GPUDATA_SCOPE(STAT_GpuData_CalculateSlice, Slicing);
+
+	const FLabeledPointCloud* CachedCloud = Cache.IsNull() ? nullptr : Cache->FindLabeledCloud(CloudCacheTag);
+	if (!CachedCloud)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Labeled point cloud is not cached!"));
+		return {};
+	}
+
+	const uint16 Label = LabelName.IsEmpty() ? 0 : CachedCloud->FindLabel(LabelName);
+	if (!LabelName.IsEmpty() && Label == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Label %s is not in cloud %s"), *LabelName, *CloudCacheTag.ToString());
+	}
+
+	TArray<float> Output;
+	Output.SetNumZeroed(TargetImageSize.X * TargetImageSize.Y);
+
+	const FIntVector& Density = CachedCloud->PointDensity;
+	const TArray<uint16>& Labels = CachedCloud->Labels;
+	ForEachSlicePixel(PlaneOrigin, PlaneRotation, PointCloudExtent, PointCloudOrigin, ImagePhysicalSize, TargetImageSize,
+		Density, [&](int32 PixelIndex, const FIntVector& LocalCloudCoords)
+	{
+		if (LabelName.IsEmpty())
+		{
+			// Label of the closest point, averaging labels has no meaning
+			Output[PixelIndex] = Labels[static_cast<int32>(FPointCloud::ToPlainIndex(LocalCloudCoords, Density))];
+		}
+		else if (Label != 0)
+		{
+			Output[PixelIndex] = AverageNeighbours(LocalCloudCoords, Density, [&](const FIntVector& Coords)
+			{
+				return Labels[static_cast<int32>(FPointCloud::ToPlainIndex(Coords, Density))] == Label;
+			});
+		}
+	});
+
+	return FSlice(MoveTemp(Output), ImagePhysicalSize, TargetImageSize);
+}
+
 FSlice UActorSlicer::CalculateOrLoadSliceOnPlane(const FVector& PlaneOrigin, const FRotator& PlaneRotation,
 	const FVector& PointCloudExtent, const FRotator& PointCloudRotation, const FVector& PointCloudOrigin,
-	const FVector2D& ImagePhysicalSize, const FIntPoint& TargetImageSize, const FName& SliceTag)
+	const FVector2D& ImagePhysicalSize, const FIntPoint& TargetImageSize, const FName& SliceTag, bool& WasCached)
 {
+	WasCached = false;
 	if (Cache.IsNull())
 	{
 		UE_LOG(LogTemp, Error, TEXT("Cache is null, can't calculate slice"));
 		return {};
 	}
 	
+	// Cache lookups below are part of this request in the trace
+	FSliceRequestRecorder::FScopedRequest Request(Cache->GetRecorder(), ESliceRequestKind::CalculateOrLoadSlice);
+	if (Request.IsRecording())
+	{
+		FSliceRequestRecord& Record = Request.Record;
+		Record.CloudTag = CloudCacheTag;
+		Record.SliceTag = SliceTag;
+		Record.PlaneOrigin = FVector3f(PlaneOrigin);
+		Record.PlaneRotation = FRotator3f(PlaneRotation);
+		Record.PointCloudExtent = FVector3f(PointCloudExtent);
+		Record.PointCloudRotation = FRotator3f(PointCloudRotation);
+		Record.PointCloudOrigin = FVector3f(PointCloudOrigin);
+		Record.ImagePhysicalSize = FVector2f(ImagePhysicalSize);
+		Record.TargetImageSize = TargetImageSize;
+	}
+
 	// Check for cache
 	bool Success;
 	FSlice SliceFromCache = Cache->GetSlice(CloudCacheTag, SliceTag, Success);
+	Request.Record.Hit = Success;
+	WasCached = Success;
 
 	if (Success)
 	{
@@ -429,6 +1554,102 @@ FSlice UActorSlicer::CalculateOrLoadSliceOnPlane(const FVector& PlaneOrigin, con
 	return NewSlice;
 }
 
+FSliceContours UActorSlicer::CalculateOrLoadSliceContours(const FVector& PlaneOrigin, const FRotator& PlaneRotation,
+	const FVector& PointCloudExtent, const FRotator& PointCloudRotation, const FVector& PointCloudOrigin,
+	const FVector2D& ImagePhysicalSize, const FIntPoint& TargetImageSize, const FName& SliceTag, float IsoValue)
+{
+	if (Cache.IsNull())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Cache is null, can't calculate contours"));
+		return {};
+	}
+
+	// Contours are dropped by the cache when the slice changes, so cached ones match the cached slice
+	const FSliceContours* CachedContours = Cache->FindSliceContours(CloudCacheTag, SliceTag);
+	if (CachedContours && CachedContours->IsoValue == IsoValue)
+	{
+		return *CachedContours;
+	}
+
+	bool WasCached;
+	const FSlice Slice = CalculateOrLoadSliceOnPlane(PlaneOrigin, PlaneRotation, PointCloudExtent, PointCloudRotation,
+		PointCloudOrigin, ImagePhysicalSize, TargetImageSize, SliceTag, WasCached);
+	if (Slice.Data.IsEmpty() || Slice.Data.Num() < Slice.Resolution.X * Slice.Resolution.Y)
+	{
+		// Failed slice, keep the cache free of empty contours so the next call retries
+		return {};
+	}
+	FSliceContours Contours = FSliceContours::Extract(Slice, IsoValue);
+	Cache->SetSliceContours(CloudCacheTag, SliceTag, Contours);
+	return Contours;
+}
+
+void UActorSlicer::DrawSliceContours(const FSliceContours& Contours, const FVector& PlaneOrigin, const FRotator& PlaneRotation,
+	const FVector& PointCloudOrigin, FLinearColor Color, float Thickness, float LifeTime)
+{
+	if (!ContourLineBatch)
+	{
+		if (!GetOwner())
+		{
+			return;
+		}
+		ContourLineBatch = NewObject<ULineBatchComponent>(GetOwner(), TEXT("SliceContourLines"));
+		ContourLineBatch->RegisterComponent();
+	}
+
+	// Same projection center and axes as CalculateSliceOnPlane
+	const FRotationMatrix PlaneRotator(PlaneRotation);
+	const FVector PlaneNormal = PlaneRotator.GetUnitAxis(EAxis::Z);
+	const FVector XAxis = PlaneRotator.GetUnitAxis(EAxis::X);
+	const FVector YAxis = PlaneRotator.GetUnitAxis(EAxis::Y);
+	const FPlane Plane(PlaneOrigin, PlaneNormal);
+	const FVector ProjectionCenter = PointCloudOrigin - Plane.PlaneDot(PointCloudOrigin) * PlaneNormal;
+	auto ToWorld = [&](const FVector2D& Point)
+	{
+		return ProjectionCenter + XAxis * Point.X + YAxis * Point.Y;
+	};
+
+	for (const FSliceContour& Contour : Contours.Contours)
+	{
+		const int32 SegmentCount = Contour.bClosed ? Contour.Points.Num() : Contour.Points.Num() - 1;
+		for (int32 Index = 0; Index < SegmentCount; ++Index)
+		{
+			const FVector2D& Next = Contour.Points[(Index + 1) % Contour.Points.Num()];
+			ContourLineBatch->DrawLine(ToWorld(Contour.Points[Index]), ToWorld(Next), Color, SDPG_World, Thickness, LifeTime);
+		}
+	}
+}
+
+void UActorSlicer::ClearSliceContours()
+{
+	if (ContourLineBatch)
+	{
+		ContourLineBatch->Flush();
+	}
+}
+
+bool UActorSlicer::Bake(UCloudCache* TargetCache)
+{
+	if (!BakeSettings.bBake || !TargetCache || !GetOwner())
+	{
+		return false;
+	}
+
+	const FVector OwnerLocation = GetOwner()->GetActorLocation();
+	const FVector BoxLocation = OwnerLocation + BakeSettings.BoxLocation;
+	SetCachePointer(TargetCache, BakeSettings.CloudCacheTag);
+	GeneratePointCloud(BoxLocation, BakeSettings.BoxExtent, BakeSettings.PointDensity);
+
+	for (const FSliceBakeRequest& Request : BakeSettings.Slices)
+	{
+		bool WasCached;
+		CalculateOrLoadSliceOnPlane(OwnerLocation + Request.PlaneOrigin, Request.PlaneRotation,
+			BakeSettings.BoxExtent, FRotator::ZeroRotator, BoxLocation,
+			Request.ImagePhysicalSize, Request.TargetImageSize, Request.SliceTag, WasCached);
+	}
+	return true;
+}
+
 void UActorSlicer::CacheSlice(FSlice Slice, FName SliceTag)
 {
 	Cache->SetSlice(CloudCacheTag, SliceTag, std::move(Slice));
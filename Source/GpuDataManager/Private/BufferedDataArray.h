@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GenericDataArray.h"
+#include <atomic>
+
+/*
+ * @USAGE
+ *
+ * Triple-buffered TGenericDataArray for one producer thread and one consumer (game) thread
+ * Producer fills GetWriteBuffer() completely and calls Publish()
+ * Consumer calls Consume() and reads GetReadBuffer(), which is the latest published buffer
+ * Neither side locks or copies; write buffer content is an older frame and must be overwritten
+ * 
+ */
+template <typename T>
+class TBufferedDataArray
+{
+public:
+	explicit TBufferedDataArray(int32 Capacity, int32 RowWidth = 0)
+		: Buffers {
+			TGenericDataArray<T>(Capacity, true, RowWidth),
+			TGenericDataArray<T>(Capacity, true, RowWidth),
+			TGenericDataArray<T>(Capacity, true, RowWidth) }
+	{
+	}
+
+	// Producer side
+	TGenericDataArray<T>& GetWriteBuffer()
+	{
+		return Buffers[WriteIndex];
+	}
+
+	void Publish()
+	{
+		const uint32 Previous = Middle.exchange(WriteIndex | PublishedFlag, std::memory_order_acq_rel);
+		WriteIndex = Previous & IndexMask;
+	}
+
+	// Consumer side, returns true if a newer buffer was taken
+	bool Consume()
+	{
+		if (!HasPublished())
+		{
+			return false;
+		}
+		const uint32 Previous = Middle.exchange(ReadIndex, std::memory_order_acq_rel);
+		ReadIndex = Previous & IndexMask;
+
+		// Staging texture holds an older buffer, dirty tiles of this one are relative to its own history
+		Buffers[ReadIndex].MarkAllDirty();
+		return true;
+	}
+
+	bool HasPublished() const
+	{
+		return (Middle.load(std::memory_order_acquire) & PublishedFlag) != 0;
+	}
+
+	TGenericDataArray<T>& GetReadBuffer()
+	{
+		return Buffers[ReadIndex];
+	}
+
+private:
+	static constexpr uint32 IndexMask = 0x3;
+	static constexpr uint32 PublishedFlag = 0x4;
+
+	TGenericDataArray<T> Buffers[3];
+
+	// Owned by producer and consumer respectively, Middle is exchanged between them
+	uint32 WriteIndex = 0;
+	uint32 ReadIndex = 1;
+	std::atomic<uint32> Middle { 2 };
+};
@@ -2,10 +2,88 @@
 
 
 #include "CloudCache.h"
+#include "HAL/FileManager.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "GpuDataManagerStats.h"
+
+#define LOG_ERROR(ErrorText) UE_LOG(LogTemp, Warning, TEXT("CloudCache %s: %s"), *FString(__func__), *FString(ErrorText));
+
+const FCloudPack& UCloudCache::GetFullPack(TOptional<FCloudPack>& Storage) const
+{
+	if (CloudTier.Spilled.Num() == 0 && SliceTier.Spilled.Num() == 0 && SliceStackTier.Spilled.Num() == 0 &&
+		LabeledCloudTier.Spilled.Num() == 0 && CompressedCloudTier.Spilled.Num() == 0 &&
+		SliceContourTier.Spilled.Num() == 0 && OpenSliceStacks.IsEmpty())
+	{
+		return CloudPack;
+	}
+
+	// Spilled payloads and open stacks are not in CloudPack, add them to a temporary copy
+	Storage.Emplace(CloudPack);
+	// Stored versions open stacks were reopened from, dropped when open stacks replace all of their references
+	TMap<FString, int32> ReplacedStackRefs;
+	TSet<FString> OpenStackHashes;
+	for (const auto& [CloudTag, CloudStacks] : OpenSliceStacks)
+	{
+		for (const auto& [StackTag, Stack] : CloudStacks)
+		{
+			FString& StackHash = Storage->Data.FindOrAdd(CloudTag).SliceStackHashes.FindOrAdd(StackTag);
+			if (!StackHash.IsEmpty())
+			{
+				++ReplacedStackRefs.FindOrAdd(StackHash);
+			}
+			StackHash = Stack.GetContentHash();
+			OpenStackHashes.Add(StackHash);
+			Storage->SliceStacks.Add(StackHash, Stack).Shrink();
+		}
+	}
+	TSet<FString> OrphanedStackHashes;
+	for (const auto& [Hash, Replaced] : ReplacedStackRefs)
+	{
+		const int32* RefCount = SliceStackTier.RefCounts.Find(Hash);
+		if ((!RefCount || *RefCount <= Replaced) && !OpenStackHashes.Contains(Hash))
+		{
+			OrphanedStackHashes.Add(Hash);
+			Storage->SliceStacks.Remove(Hash);
+		}
+	}
+	for (const auto& [Hash, Spilled] : CloudTier.Spilled)
+	{
+		ReadSpilledBlob(CloudTier, Hash, Storage->Clouds.Add(Hash));
+	}
+	for (const auto& [Hash, Spilled] : SliceTier.Spilled)
+	{
+		ReadSpilledBlob(SliceTier, Hash, Storage->Slices.Add(Hash));
+	}
+	for (const auto& [Hash, Spilled] : SliceStackTier.Spilled)
+	{
+		if (!OrphanedStackHashes.Contains(Hash))
+		{
+			ReadSpilledBlob(SliceStackTier, Hash, Storage->SliceStacks.Add(Hash));
+		}
+	}
+	for (const auto& [Hash, Spilled] : LabeledCloudTier.Spilled)
+	{
+		ReadSpilledBlob(LabeledCloudTier, Hash, Storage->LabeledClouds.Add(Hash));
+	}
+	for (const auto& [Hash, Spilled] : CompressedCloudTier.Spilled)
+	{
+		ReadSpilledBlob(CompressedCloudTier, Hash, Storage->CompressedClouds.Add(Hash));
+	}
+	for (const auto& [Hash, Spilled] : SliceContourTier.Spilled)
+	{
+		ReadSpilledBlob(SliceContourTier, Hash, Storage->SliceContours.Add(Hash));
+	}
+	return Storage.GetValue();
+}
 
 void UCloudCache::Save() const
 {
-	const auto JsonObject = CloudPack.ToJsonObject({});
+	TOptional<FCloudPack> FullPackStorage;
+	const auto JsonObject = GetFullPack(FullPackStorage).ToJsonObject({});
 	if (!JsonObject)
 	{
 		// Error
@@ -45,52 +123,612 @@ void UCloudCache::Load()
 		return;
 	}
 
+	ResetTiers();
 	CloudPack.Data.Empty();
 	CloudPack = ResultStructInst.GetValue();
+	RebuildRefCounts();
+	EnforceRamBudget();
+}
+
+bool UCloudCache::SaveBinary(const FString& FileName) const
+{
+	TOptional<FCloudPack> FullPackStorage;
+	return FCloudPack::WriteToBinaryFile(GetFullPack(FullPackStorage), FileName);
+}
+
+bool UCloudCache::LoadBinary(const FString& FileName)
+{
+	auto ResultStructInst = FCloudPack::ReadFromBinaryFile(FileName);
+	if (!ResultStructInst)
+	{
+		return false;
+	}
+
+	ResetTiers();
+	CloudPack = MoveTemp(ResultStructInst.GetValue());
+	RebuildRefCounts();
+	EnforceRamBudget();
+	return true;
+}
+
+bool UCloudCache::LoadBaked()
+{
+	return LoadBinary(GetBakedFileName());
+}
+
+FString UCloudCache::GetBakedFileName()
+{
+	return FPaths::ProjectContentDir() / TEXT("CloudCache/Baked.cloudcache");
+}
+
+template <typename T>
+FString UCloudCache::AddBlob(TMap<FString, T>& Blobs, FBlobTier& Tier, T Value)
+{
+	FString Hash = Value.GetContentHash();
+
+	// Probe on the (unlikely) hash collision with different content
+	for (int32 Probe = 1; ; ++Probe)
+	{
+		if (!Tier.RefCounts.Contains(Hash))
+		{
+			const int64 Bytes = Value.GetAllocatedSize();
+			Blobs.Add(Hash, std::move(Value));
+			Tier.RefCounts.Add(Hash, 1);
+			Tier.Resident.Add(Hash, {});
+			TouchBlob(Tier, Hash, Bytes);
+			EnforceRamBudget(Hash);
+			return Hash;
+		}
+
+		const T* Existing = FindBlob(Blobs, Tier, Hash);
+		if (Existing && *Existing == Value)
+		{
+			++Tier.RefCounts.FindOrAdd(Hash);
+			return Hash;
+		}
+		Hash = FString::Printf(TEXT("%s-%d"), *Value.GetContentHash(), Probe);
+	}
+}
+
+template <typename T>
+void UCloudCache::ReleaseBlob(TMap<FString, T>& Blobs, FBlobTier& Tier, const FString& Hash)
+{
+	int32* RefCount = Tier.RefCounts.Find(Hash);
+	if (!RefCount || --(*RefCount) > 0)
+	{
+		return;
+	}
+	Tier.RefCounts.Remove(Hash);
+	Blobs.Remove(Hash);
+
+	FBlobResidency Residency;
+	if (Tier.Resident.RemoveAndCopyValue(Hash, Residency))
+	{
+		ResidentBytes -= Residency.Bytes;
+	}
+
+	FSpilledBlob Spilled;
+	if (Tier.Spilled.RemoveAndCopyValue(Hash, Spilled))
+	{
+		IFileManager::Get().Delete(*Spilled.FileName);
+	}
+}
+
+template <typename T>
+T* UCloudCache::FindBlob(TMap<FString, T>& Blobs, FBlobTier& Tier, const FString& Hash)
+{
+	if (T* Value = Blobs.Find(Hash))
+	{
+		TouchBlob(Tier, Hash, Value->GetAllocatedSize());
+		return Value;
+	}
+
+	if (!Tier.Spilled.Contains(Hash))
+	{
+		return nullptr;
+	}
+
+	// Fault payload back from disk
+	const double FaultStart = FPlatformTime::Seconds();
+	T Value;
+	if (!ReadSpilledBlob(Tier, Hash, Value))
+	{
+		return nullptr;
+	}
+	const int64 Bytes = Value.GetAllocatedSize();
+	Blobs.Add(Hash, std::move(Value));
+	IFileManager::Get().Delete(*Tier.Spilled.FindAndRemoveChecked(Hash).FileName);
+	Tier.Resident.Add(Hash, {});
+	TouchBlob(Tier, Hash, Bytes);
+
+	const double FaultSeconds = FPlatformTime::Seconds() - FaultStart;
+	++FaultCount;
+	TotalFaultSeconds += FaultSeconds;
+	MaxFaultSeconds = FMath::Max(MaxFaultSeconds, FaultSeconds);
+
+	// Eviction only removes elements, so it never relocates the faulted payload
+	EnforceRamBudget(Hash);
+	return Blobs.Find(Hash);
+}
+
+template <typename T>
+bool UCloudCache::SpillBlob(TMap<FString, T>& Blobs, FBlobTier& Tier, const FString& Hash)
+{
+	T* Value = Blobs.Find(Hash);
+	if (!Value)
+	{
+		return false;
+	}
+
+	GPUDATA_SCOPE(STAT_GpuData_Serialization, Serialization);
+	TArray<uint8> RawBytes;
+	FMemoryWriter Writer(RawBytes);
+	Writer << *Value;
+
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, RawBytes.Num());
+	TArray<uint8> CompressedBytes;
+	CompressedBytes.SetNumUninitialized(CompressedSize);
+	if (!FCompression::CompressMemory(NAME_Zlib, CompressedBytes.GetData(), CompressedSize, RawBytes.GetData(), RawBytes.Num()))
+	{
+		LOG_ERROR("Can't compress payload");
+		return false;
+	}
+	CompressedBytes.SetNum(CompressedSize);
+
+	const FString FileName = GetSpillDirectory() / Hash + TEXT(".bin");
+	if (!FFileHelper::SaveArrayToFile(CompressedBytes, *FileName))
+	{
+		LOG_ERROR("Can't write spill file");
+		return false;
+	}
+
+	FGpuDataManagerStats::AddBytesSerialized(CompressedSize);
+	Tier.Spilled.Add(Hash, { FileName, RawBytes.Num(), CompressedSize });
+	ResidentBytes -= Tier.Resident.FindAndRemoveChecked(Hash).Bytes;
+	Blobs.Remove(Hash);
+	return true;
+}
+
+template <typename T>
+bool UCloudCache::ReadSpilledBlob(const FBlobTier& Tier, const FString& Hash, T& Out) const
+{
+	GPUDATA_SCOPE(STAT_GpuData_Serialization, Serialization);
+	const FSpilledBlob* Spilled = Tier.Spilled.Find(Hash);
+	TArray<uint8> CompressedBytes;
+	if (!Spilled || !FFileHelper::LoadFileToArray(CompressedBytes, *Spilled->FileName))
+	{
+		LOG_ERROR("Can't read spill file");
+		return false;
+	}
+
+	TArray<uint8> RawBytes;
+	RawBytes.SetNumUninitialized(Spilled->RawBytes);
+	if (!FCompression::UncompressMemory(NAME_Zlib, RawBytes.GetData(), RawBytes.Num(), CompressedBytes.GetData(), CompressedBytes.Num()))
+	{
+		LOG_ERROR("Can't decompress spill file");
+		return false;
+	}
+
+	FGpuDataManagerStats::AddBytesSerialized(CompressedBytes.Num());
+	FMemoryReader Reader(RawBytes);
+	Reader << Out;
+	return !Reader.IsError();
+}
+
+void UCloudCache::TouchBlob(FBlobTier& Tier, const FString& Hash, int64 Bytes)
+{
+	if (FBlobResidency* Residency = Tier.Resident.Find(Hash))
+	{
+		// First touch after insertion accounts the payload size
+		ResidentBytes += Bytes - Residency->Bytes;
+		Residency->Bytes = Bytes;
+		Residency->LastAccess = ++AccessCounter;
+	}
+}
+
+void UCloudCache::EnforceRamBudget(const FString& PinnedHash)
+{
+	if (RamBudgetBytes <= 0 || ResidentBytes <= RamBudgetBytes)
+	{
+		return;
+	}
+
+	struct FCandidate
+	{
+		uint64 LastAccess;
+		const FString* Hash;
+		const FBlobTier* Tier;
+	};
+	TArray<FCandidate> Candidates;
+	Candidates.Reserve(CloudTier.Resident.Num() + SliceTier.Resident.Num() + SliceStackTier.Resident.Num() +
+		LabeledCloudTier.Resident.Num() + CompressedCloudTier.Resident.Num() + SliceContourTier.Resident.Num());
+	for (const FBlobTier* Tier : { &CloudTier, &SliceTier, &SliceStackTier, &LabeledCloudTier, &CompressedCloudTier, &SliceContourTier })
+	{
+		for (const auto& [Hash, Residency] : Tier->Resident)
+		{
+			Candidates.Add({ Residency.LastAccess, &Hash, Tier });
+		}
+	}
+	Candidates.Sort([](const FCandidate& A, const FCandidate& B) { return A.LastAccess < B.LastAccess; });
+
+	// Hash pointers stay valid, spilling only removes the spilled key from Resident
+	for (const FCandidate& Candidate : Candidates)
+	{
+		if (ResidentBytes <= RamBudgetBytes)
+		{
+			break;
+		}
+		const FString Hash = *Candidate.Hash;
+		if (Hash == PinnedHash)
+		{
+			continue;
+		}
+		if (Candidate.Tier == &CloudTier)
+		{
+			SpillBlob(CloudPack.Clouds, CloudTier, Hash);
+		}
+		else if (Candidate.Tier == &SliceTier)
+		{
+			SpillBlob(CloudPack.Slices, SliceTier, Hash);
+		}
+		else if (Candidate.Tier == &SliceStackTier)
+		{
+			SpillBlob(CloudPack.SliceStacks, SliceStackTier, Hash);
+		}
+		else if (Candidate.Tier == &LabeledCloudTier)
+		{
+			SpillBlob(CloudPack.LabeledClouds, LabeledCloudTier, Hash);
+		}
+		else if (Candidate.Tier == &CompressedCloudTier)
+		{
+			SpillBlob(CloudPack.CompressedClouds, CompressedCloudTier, Hash);
+		}
+		else
+		{
+			SpillBlob(CloudPack.SliceContours, SliceContourTier, Hash);
+		}
+	}
+}
+
+void UCloudCache::ReleaseSlices(const FName& CloudTag, FCloudRefs& Refs)
+{
+	OpenSliceStacks.Remove(CloudTag);
+	TArray<FName> ReleasedSliceTags;
+	Refs.SliceHashes.GenerateKeyArray(ReleasedSliceTags);
+	for (const auto& [SliceTag, SliceHash] : Refs.SliceHashes)
+	{
+		ReleaseBlob(CloudPack.Slices, SliceTier, SliceHash);
+	}
+	for (const auto& [StackTag, StackHash] : Refs.SliceStackHashes)
+	{
+		ReleaseBlob(CloudPack.SliceStacks, SliceStackTier, StackHash);
+	}
+	for (const auto& [SliceTag, ContourHash] : Refs.SliceContourHashes)
+	{
+		ReleaseBlob(CloudPack.SliceContours, SliceContourTier, ContourHash);
+	}
+	Refs.SliceHashes.Empty();
+	Refs.SliceStackHashes.Empty();
+	Refs.SliceContourHashes.Empty();
+
+	for (const FName& SliceTag : ReleasedSliceTags)
+	{
+		OnSliceChanged.Broadcast(CloudTag, SliceTag);
+	}
+}
+
+void UCloudCache::ReleaseClouds(FCloudRefs& Refs)
+{
+	if (!Refs.CloudHash.IsEmpty())
+	{
+		ReleaseBlob(CloudPack.Clouds, CloudTier, Refs.CloudHash);
+	}
+	if (!Refs.CompressedCloudHash.IsEmpty())
+	{
+		ReleaseBlob(CloudPack.CompressedClouds, CompressedCloudTier, Refs.CompressedCloudHash);
+	}
+	Refs.CloudHash.Empty();
+	Refs.CompressedCloudHash.Empty();
+}
+
+void UCloudCache::ReleaseSliceContours(FCloudRefs& Refs, const FName& SliceTag)
+{
+	FString ContourHash;
+	if (Refs.SliceContourHashes.RemoveAndCopyValue(SliceTag, ContourHash))
+	{
+		ReleaseBlob(CloudPack.SliceContours, SliceContourTier, ContourHash);
+	}
+}
+
+void UCloudCache::ResetTiers()
+{
+	for (const FBlobTier* Tier : { &CloudTier, &SliceTier, &SliceStackTier, &LabeledCloudTier, &CompressedCloudTier, &SliceContourTier })
+	{
+		for (const auto& [Hash, Spilled] : Tier->Spilled)
+		{
+			IFileManager::Get().Delete(*Spilled.FileName);
+		}
+	}
+	CloudTier = {};
+	SliceTier = {};
+	SliceStackTier = {};
+	LabeledCloudTier = {};
+	CompressedCloudTier = {};
+	SliceContourTier = {};
+	OpenSliceStacks.Empty();
+	ResidentBytes = 0;
+}
+
+void UCloudCache::RebuildRefCounts()
+{
+	CloudTier.RefCounts.Empty(CloudPack.Clouds.Num());
+	SliceTier.RefCounts.Empty(CloudPack.Slices.Num());
+	SliceStackTier.RefCounts.Empty(CloudPack.SliceStacks.Num());
+	LabeledCloudTier.RefCounts.Empty(CloudPack.LabeledClouds.Num());
+	CompressedCloudTier.RefCounts.Empty(CloudPack.CompressedClouds.Num());
+	SliceContourTier.RefCounts.Empty(CloudPack.SliceContours.Num());
+	for (const auto& [CloudTag, Refs] : CloudPack.Data)
+	{
+		if (!Refs.CloudHash.IsEmpty())
+		{
+			++CloudTier.RefCounts.FindOrAdd(Refs.CloudHash);
+		}
+		for (const auto& [SliceTag, SliceHash] : Refs.SliceHashes)
+		{
+			++SliceTier.RefCounts.FindOrAdd(SliceHash);
+		}
+		for (const auto& [StackTag, StackHash] : Refs.SliceStackHashes)
+		{
+			++SliceStackTier.RefCounts.FindOrAdd(StackHash);
+		}
+		if (!Refs.LabeledCloudHash.IsEmpty())
+		{
+			++LabeledCloudTier.RefCounts.FindOrAdd(Refs.LabeledCloudHash);
+		}
+		if (!Refs.CompressedCloudHash.IsEmpty())
+		{
+			++CompressedCloudTier.RefCounts.FindOrAdd(Refs.CompressedCloudHash);
+		}
+		for (const auto& [SliceTag, ContourHash] : Refs.SliceContourHashes)
+		{
+			++SliceContourTier.RefCounts.FindOrAdd(ContourHash);
+		}
+	}
+
+	for (const auto& [Hash, Cloud] : CloudPack.Clouds)
+	{
+		CloudTier.Resident.Add(Hash, {});
+		TouchBlob(CloudTier, Hash, Cloud.GetAllocatedSize());
+	}
+	for (const auto& [Hash, Slice] : CloudPack.Slices)
+	{
+		SliceTier.Resident.Add(Hash, {});
+		TouchBlob(SliceTier, Hash, Slice.GetAllocatedSize());
+	}
+	for (const auto& [Hash, Stack] : CloudPack.SliceStacks)
+	{
+		SliceStackTier.Resident.Add(Hash, {});
+		TouchBlob(SliceStackTier, Hash, Stack.GetAllocatedSize());
+	}
+	for (const auto& [Hash, Cloud] : CloudPack.LabeledClouds)
+	{
+		LabeledCloudTier.Resident.Add(Hash, {});
+		TouchBlob(LabeledCloudTier, Hash, Cloud.GetAllocatedSize());
+	}
+	for (const auto& [Hash, Cloud] : CloudPack.CompressedClouds)
+	{
+		CompressedCloudTier.Resident.Add(Hash, {});
+		TouchBlob(CompressedCloudTier, Hash, Cloud.GetAllocatedSize());
+	}
+	for (const auto& [Hash, Contours] : CloudPack.SliceContours)
+	{
+		SliceContourTier.Resident.Add(Hash, {});
+		TouchBlob(SliceContourTier, Hash, Contours.GetAllocatedSize());
+	}
+}
+
+FString UCloudCache::GetSpillDirectory() const
+{
+	const FString Root = SpillDirectory.IsEmpty() ? FPaths::ProjectSavedDir() / TEXT("CloudCacheSpill") : SpillDirectory;
+	return Root / SpillGuid.ToString();
 }
 
 void UCloudCache::SetCloudValue(const FName& CloudTag, FPointCloud Cloud)
 {
-	CloudPack.Data.FindOrAdd(CloudTag).PointCloud = std::move(Cloud);
+	const FString NewHash = AddBlob(CloudPack.Clouds, CloudTier, std::move(Cloud));
+	FCloudRefs& Refs = CloudPack.Data.FindOrAdd(CloudTag);
+	ReleaseClouds(Refs);
+	Refs.CloudHash = NewHash;
+	// Unknown origin, SetCloudValueWithKey restores the key
+	Refs.GenerationKey.Empty();
 }
 
-FCloud UCloudCache::GetCloudWithSlices(const FName& CloudTag, bool &Success)
+void UCloudCache::SetCloudValueWithKey(const FName& CloudTag, FPointCloud Cloud, const FString& GenerationKey)
+{
+	if (FCloudRefs* Refs = CloudPack.Data.Find(CloudTag); Refs && Refs->GenerationKey != GenerationKey)
+	{
+		// Slices were taken from the stale cloud
+		ReleaseSlices(CloudTag, *Refs);
+	}
+
+	SetCloudValue(CloudTag, std::move(Cloud));
+	CloudPack.Data.FindChecked(CloudTag).GenerationKey = GenerationKey;
+}
+
+void UCloudCache::SetCompressedCloudValueWithKey(const FName& CloudTag, FRlePointCloud Cloud, const FString& GenerationKey)
+{
+	if (FCloudRefs* Refs = CloudPack.Data.Find(CloudTag); Refs && Refs->GenerationKey != GenerationKey)
+	{
+		// Slices were taken from the stale cloud
+		ReleaseSlices(CloudTag, *Refs);
+	}
+
+	const FString NewHash = AddBlob(CloudPack.CompressedClouds, CompressedCloudTier, std::move(Cloud));
+	FCloudRefs& Refs = CloudPack.Data.FindOrAdd(CloudTag);
+	ReleaseClouds(Refs);
+	Refs.CompressedCloudHash = NewHash;
+	Refs.GenerationKey = GenerationKey;
+}
+
+const FRlePointCloud* UCloudCache::FindCompressedCloud(const FName& CloudTag)
+{
+	GPUDATA_SCOPE(STAT_GpuData_CacheLookup, CacheLookup);
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	const bool HasCloud = Refs && !Refs->CompressedCloudHash.IsEmpty();
+	const FRlePointCloud* Cloud = HasCloud ? FindBlob(CloudPack.CompressedClouds, CompressedCloudTier, Refs->CompressedCloudHash) : nullptr;
+	FGpuDataManagerStats::AddCacheLookup(Cloud != nullptr);
+	return Cloud;
+}
+
+bool UCloudCache::HasCompressedCloud(const FName& CloudTag) const
+{
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	return Refs && !Refs->CompressedCloudHash.IsEmpty();
+}
+
+const FPointCloud* UCloudCache::FindCloud(const FName& CloudTag)
+{
+	GPUDATA_SCOPE(STAT_GpuData_CacheLookup, CacheLookup);
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	const bool HasCloud = Refs && !Refs->CloudHash.IsEmpty();
+	const FPointCloud* Cloud = HasCloud ? FindBlob(CloudPack.Clouds, CloudTier, Refs->CloudHash) : nullptr;
+	FGpuDataManagerStats::AddCacheLookup(Cloud != nullptr);
+	return Cloud;
+}
+
+FString UCloudCache::GetCloudGenerationKey(const FName& CloudTag, bool& Success) const
 {
-	const auto Value = CloudPack.Data.Find(CloudTag);
-	Success = Value != nullptr;
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	Success = Refs && (!Refs->CloudHash.IsEmpty() || !Refs->CompressedCloudHash.IsEmpty());
 	if (Success)
 	{
-		return *Value;
+		return Refs->GenerationKey;
 	}
 	return {};
 }
 
+FCloud UCloudCache::GetCloudWithSlices(const FName& CloudTag, bool &Success)
+{
+	GPUDATA_SCOPE(STAT_GpuData_CacheLookup, CacheLookup);
+	FSliceRequestRecorder::FScopedRequest Request(Recorder.Get(), ESliceRequestKind::GetCloudWithSlices);
+	Request.Record.CloudTag = CloudTag;
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	Success = Refs != nullptr;
+	Request.Record.Hit = Success;
+	FGpuDataManagerStats::AddCacheLookup(Success);
+	if (!Success)
+	{
+		return {};
+	}
+
+	FCloud Result;
+	if (const auto Cloud = FindBlob(CloudPack.Clouds, CloudTier, Refs->CloudHash))
+	{
+		Result.PointCloud = *Cloud;
+	}
+	else if (const auto CompressedCloud = FindBlob(CloudPack.CompressedClouds, CompressedCloudTier, Refs->CompressedCloudHash))
+	{
+		Result.PointCloud = CompressedCloud->Decode();
+	}
+	for (const auto& [SliceTag, SliceHash] : Refs->SliceHashes)
+	{
+		if (const auto Slice = FindBlob(CloudPack.Slices, SliceTier, SliceHash))
+		{
+			Result.SlicePack.Data.Add(SliceTag, *Slice);
+		}
+	}
+	return Result;
+}
+
 FPointCloud UCloudCache::GetCloud(const FName& CloudTag, bool &Success)
 {
-	const auto Value = CloudPack.Data.Find(CloudTag);
-	Success = Value != nullptr;
-	if ( Value)
+	GPUDATA_SCOPE(STAT_GpuData_CacheLookup, CacheLookup);
+	FSliceRequestRecorder::FScopedRequest Request(Recorder.Get(), ESliceRequestKind::GetCloud);
+	Request.Record.CloudTag = CloudTag;
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	const auto Value = Refs ? FindBlob(CloudPack.Clouds, CloudTier, Refs->CloudHash) : nullptr;
+	const auto CompressedValue = Refs && !Value ? FindBlob(CloudPack.CompressedClouds, CompressedCloudTier, Refs->CompressedCloudHash) : nullptr;
+	Success = Value || CompressedValue;
+	Request.Record.Hit = Success;
+	FGpuDataManagerStats::AddCacheLookup(Success);
+	if (Value)
+	{
+		return *Value;
+	}
+	if (CompressedValue)
+	{
+		return CompressedValue->Decode();
+	}
+	return {};
+}
+
+void UCloudCache::SetLabeledCloud(const FName& CloudTag, FLabeledPointCloud Cloud)
+{
+	const FString NewHash = AddBlob(CloudPack.LabeledClouds, LabeledCloudTier, std::move(Cloud));
+	FCloudRefs& Refs = CloudPack.Data.FindOrAdd(CloudTag);
+	if (!Refs.LabeledCloudHash.IsEmpty())
+	{
+		ReleaseBlob(CloudPack.LabeledClouds, LabeledCloudTier, Refs.LabeledCloudHash);
+	}
+	Refs.LabeledCloudHash = NewHash;
+}
+
+FLabeledPointCloud UCloudCache::GetLabeledCloud(const FName& CloudTag, bool& Success)
+{
+	const FLabeledPointCloud* Cloud = FindLabeledCloud(CloudTag);
+	Success = Cloud != nullptr;
+	if (Cloud)
 	{
-		return Value->PointCloud;
+		return *Cloud;
 	}
 	return {};
 }
 
+const FLabeledPointCloud* UCloudCache::FindLabeledCloud(const FName& CloudTag)
+{
+	GPUDATA_SCOPE(STAT_GpuData_CacheLookup, CacheLookup);
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	const bool HasCloud = Refs && !Refs->LabeledCloudHash.IsEmpty();
+	const FLabeledPointCloud* Cloud = HasCloud ? FindBlob(CloudPack.LabeledClouds, LabeledCloudTier, Refs->LabeledCloudHash) : nullptr;
+	FGpuDataManagerStats::AddCacheLookup(Cloud != nullptr);
+	return Cloud;
+}
+
 void UCloudCache::SetSlice(const FName& CloudTag, const FName& SliceTag, FSlice Slice)
 {
-	CloudPack.Data.FindOrAdd(CloudTag).SlicePack.Data.FindOrAdd(SliceTag) = std::move(Slice);
+	const FString NewHash = AddBlob(CloudPack.Slices, SliceTier, std::move(Slice));
+	FString& SliceHash = CloudPack.Data.FindOrAdd(CloudTag).SliceHashes.FindOrAdd(SliceTag);
+	if (!SliceHash.IsEmpty())
+	{
+		ReleaseBlob(CloudPack.Slices, SliceTier, SliceHash);
+	}
+	if (SliceHash != NewHash)
+	{
+		SliceHash = NewHash;
+		// Contours were extracted from the replaced slice
+		ReleaseSliceContours(CloudPack.Data.FindChecked(CloudTag), SliceTag);
+		OnSliceChanged.Broadcast(CloudTag, SliceTag);
+	}
 }
 
 FSlice UCloudCache::GetSlice(const FName& CloudTag, const FName& SliceTag, bool &Success)
 {
-	const auto Value = CloudPack.Data.Find(CloudTag);
-	if (!Value)
+	GPUDATA_SCOPE(STAT_GpuData_CacheLookup, CacheLookup);
+	FSliceRequestRecorder::FScopedRequest Request(Recorder.Get(), ESliceRequestKind::GetSlice);
+	Request.Record.CloudTag = CloudTag;
+	Request.Record.SliceTag = SliceTag;
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	if (!Refs)
 	{
 		Success = false;
+		FGpuDataManagerStats::AddCacheLookup(false);
 		return {};
 	}
-	const auto ResultValue = Value->SlicePack.Data.Find(SliceTag);
+	const auto SliceHash = Refs->SliceHashes.Find(SliceTag);
+	const auto ResultValue = SliceHash ? FindBlob(CloudPack.Slices, SliceTier, *SliceHash) : nullptr;
 	Success = ResultValue != nullptr;
+	Request.Record.Hit = Success;
+	FGpuDataManagerStats::AddCacheLookup(Success);
 	if (Success)
 	{
 		return *ResultValue;
@@ -98,17 +736,262 @@ FSlice UCloudCache::GetSlice(const FName& CloudTag, const FName& SliceTag, bool
 	return {};
 }
 
-void UCloudCache::FillByTestData()
+const FSlice* UCloudCache::FindSlice(const FName& CloudTag, const FName& SliceTag)
+{
+	GPUDATA_SCOPE(STAT_GpuData_CacheLookup, CacheLookup);
+	FSliceRequestRecorder::FScopedRequest Request(Recorder.Get(), ESliceRequestKind::FindSlice);
+	Request.Record.CloudTag = CloudTag;
+	Request.Record.SliceTag = SliceTag;
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	const auto SliceHash = Refs ? Refs->SliceHashes.Find(SliceTag) : nullptr;
+	const FSlice* Slice = SliceHash ? FindBlob(CloudPack.Slices, SliceTier, *SliceHash) : nullptr;
+	Request.Record.Hit = Slice != nullptr;
+	FGpuDataManagerStats::AddCacheLookup(Slice != nullptr);
+	return Slice;
+}
+
+void UCloudCache::SetSliceContours(const FName& CloudTag, const FName& SliceTag, FSliceContours Contours)
+{
+	const FString NewHash = AddBlob(CloudPack.SliceContours, SliceContourTier, std::move(Contours));
+	FCloudRefs& Refs = CloudPack.Data.FindOrAdd(CloudTag);
+	ReleaseSliceContours(Refs, SliceTag);
+	Refs.SliceContourHashes.Add(SliceTag, NewHash);
+}
+
+FSliceContours UCloudCache::GetSliceContours(const FName& CloudTag, const FName& SliceTag, bool& Success)
 {
-	FSlice NewSlice({ 1, 1, 1 }, { 1, 1 }, { 1, 1 });
-	CloudPack.Data = {
+	const FSliceContours* Contours = FindSliceContours(CloudTag, SliceTag);
+	Success = Contours != nullptr;
+	if (Contours)
+	{
+		return *Contours;
+	}
+	return {};
+}
+
+const FSliceContours* UCloudCache::FindSliceContours(const FName& CloudTag, const FName& SliceTag)
+{
+	GPUDATA_SCOPE(STAT_GpuData_CacheLookup, CacheLookup);
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	const auto ContourHash = Refs ? Refs->SliceContourHashes.Find(SliceTag) : nullptr;
+	const FSliceContours* Contours = ContourHash ? FindBlob(CloudPack.SliceContours, SliceContourTier, *ContourHash) : nullptr;
+	FGpuDataManagerStats::AddCacheLookup(Contours != nullptr);
+	return Contours;
+}
+
+bool UCloudCache::AppendToSliceStack(const FName& CloudTag, const FName& StackTag, const FSlice& Slice)
+{
+	TMap<FName, FSliceStack>& CloudStacks = OpenSliceStacks.FindOrAdd(CloudTag);
+	FSliceStack* Stack = CloudStacks.Find(StackTag);
+	if (!Stack)
+	{
+		// Stored stack is copied once when reopened, its tail is decoded on the first append
+		const auto Refs = CloudPack.Data.Find(CloudTag);
+		const auto StackHash = Refs ? Refs->SliceStackHashes.Find(StackTag) : nullptr;
+		const FSliceStack* Existing = StackHash ? FindBlob(CloudPack.SliceStacks, SliceStackTier, *StackHash) : nullptr;
+		Stack = &CloudStacks.Add(StackTag, Existing ? *Existing : FSliceStack());
+	}
+	if (Stack->Add(Slice))
+	{
+		return true;
+	}
+
+	if (Stack->Num() == 0)
+	{
+		CloudStacks.Remove(StackTag);
+		if (CloudStacks.IsEmpty())
 		{
-			"TestCloudTag", FCloud {
-				.PointCloud = FPointCloud({true, true, true }, { 1, 1, 1}),
-				.SlicePack = FSlicePack {
-					.Data = {{ "NewSliceTag", std::move(NewSlice) }}
-				}
-			}
+			OpenSliceStacks.Remove(CloudTag);
 		}
-	};
+	}
+	return false;
+}
+
+void UCloudCache::FinalizeSliceStack(const FName& CloudTag, const FName& StackTag)
+{
+	TMap<FName, FSliceStack>* CloudStacks = OpenSliceStacks.Find(CloudTag);
+	FSliceStack Stack;
+	if (!CloudStacks || !CloudStacks->RemoveAndCopyValue(StackTag, Stack))
+	{
+		return;
+	}
+	if (CloudStacks->IsEmpty())
+	{
+		OpenSliceStacks.Remove(CloudTag);
+	}
+	SetSliceStack(CloudTag, StackTag, MoveTemp(Stack));
+}
+
+const FSliceStack* UCloudCache::FindSliceStack(const FName& CloudTag, const FName& StackTag)
+{
+	if (const TMap<FName, FSliceStack>* CloudStacks = OpenSliceStacks.Find(CloudTag))
+	{
+		if (const FSliceStack* Stack = CloudStacks->Find(StackTag))
+		{
+			return Stack;
+		}
+	}
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	const auto StackHash = Refs ? Refs->SliceStackHashes.Find(StackTag) : nullptr;
+	return StackHash ? FindBlob(CloudPack.SliceStacks, SliceStackTier, *StackHash) : nullptr;
+}
+
+void UCloudCache::SetSliceStack(const FName& CloudTag, const FName& StackTag, FSliceStack Stack)
+{
+	// Explicitly set stack replaces the one being built
+	if (TMap<FName, FSliceStack>* CloudStacks = OpenSliceStacks.Find(CloudTag))
+	{
+		CloudStacks->Remove(StackTag);
+		if (CloudStacks->IsEmpty())
+		{
+			OpenSliceStacks.Remove(CloudTag);
+		}
+	}
+
+	Stack.Shrink();
+	const FString NewHash = AddBlob(CloudPack.SliceStacks, SliceStackTier, std::move(Stack));
+	FString& StackHash = CloudPack.Data.FindOrAdd(CloudTag).SliceStackHashes.FindOrAdd(StackTag);
+	if (!StackHash.IsEmpty())
+	{
+		ReleaseBlob(CloudPack.SliceStacks, SliceStackTier, StackHash);
+	}
+	StackHash = NewHash;
+}
+
+FSlice UCloudCache::GetSliceFromStack(const FName& CloudTag, const FName& StackTag, int32 Index, bool& Success)
+{
+	GPUDATA_SCOPE(STAT_GpuData_CacheLookup, CacheLookup);
+	FSliceRequestRecorder::FScopedRequest Request(Recorder.Get(), ESliceRequestKind::GetSliceFromStack);
+	Request.Record.CloudTag = CloudTag;
+	Request.Record.SliceTag = StackTag;
+	Request.Record.StackIndex = Index;
+	const FSliceStack* Stack = FindSliceStack(CloudTag, StackTag);
+
+	FSlice Result;
+	Success = Stack && Stack->GetSlice(Index, Result);
+	Request.Record.Hit = Success;
+	FGpuDataManagerStats::AddCacheLookup(Success);
+	return Result;
+}
+
+int32 UCloudCache::GetSliceStackNum(const FName& CloudTag, const FName& StackTag)
+{
+	const FSliceStack* Stack = FindSliceStack(CloudTag, StackTag);
+	return Stack ? Stack->Num() : 0;
+}
+
+bool UCloudCache::RemoveCloud(const FName& CloudTag)
+{
+	FCloudRefs Refs;
+	if (!CloudPack.Data.RemoveAndCopyValue(CloudTag, Refs))
+	{
+		return false;
+	}
+
+	ReleaseClouds(Refs);
+	if (!Refs.LabeledCloudHash.IsEmpty())
+	{
+		ReleaseBlob(CloudPack.LabeledClouds, LabeledCloudTier, Refs.LabeledCloudHash);
+	}
+	ReleaseSlices(CloudTag, Refs);
+	return true;
+}
+
+bool UCloudCache::RemoveSlice(const FName& CloudTag, const FName& SliceTag)
+{
+	const auto Refs = CloudPack.Data.Find(CloudTag);
+	FString SliceHash;
+	if (!Refs || !Refs->SliceHashes.RemoveAndCopyValue(SliceTag, SliceHash))
+	{
+		return false;
+	}
+
+	ReleaseBlob(CloudPack.Slices, SliceTier, SliceHash);
+	ReleaseSliceContours(*Refs, SliceTag);
+	OnSliceChanged.Broadcast(CloudTag, SliceTag);
+	return true;
+}
+
+int32 UCloudCache::GetUniqueCloudCount() const
+{
+	return CloudTier.RefCounts.Num();
+}
+
+int32 UCloudCache::GetUniqueSliceCount() const
+{
+	return SliceTier.RefCounts.Num();
+}
+
+void UCloudCache::SetRamBudget(int64 NewRamBudgetBytes)
+{
+	RamBudgetBytes = NewRamBudgetBytes;
+	EnforceRamBudget();
+}
+
+FCloudCacheStats UCloudCache::GetStats() const
+{
+	FCloudCacheStats Stats;
+	Stats.ResidentBytes = ResidentBytes;
+	for (const FBlobTier* Tier : { &CloudTier, &SliceTier, &SliceStackTier, &LabeledCloudTier, &CompressedCloudTier, &SliceContourTier })
+	{
+		Stats.ResidentBlobs += Tier->Resident.Num();
+		Stats.SpilledBlobs += Tier->Spilled.Num();
+		for (const auto& [Hash, Spilled] : Tier->Spilled)
+		{
+			Stats.SpilledBytes += Spilled.DiskBytes;
+		}
+	}
+	Stats.FaultCount = FaultCount;
+	Stats.AverageFaultLatencyMs = FaultCount > 0 ? static_cast<float>(TotalFaultSeconds * 1000.0 / FaultCount) : 0.f;
+	Stats.MaxFaultLatencyMs = static_cast<float>(MaxFaultSeconds * 1000.0);
+	return Stats;
+}
+
+void UCloudCache::FillByTestData()
+{
+	ResetTiers();
+	CloudPack = {};
+
+	FPointCloud TestCloud;
+	TestCloud.PointDensity = { 1, 1, 1 };
+	for (int32 Index = 0; Index < 3; ++Index)
+	{
+		TestCloud.Add(true);
+	}
+	SetCloudValue("TestCloudTag", MoveTemp(TestCloud));
+	SetSlice("TestCloudTag", "NewSliceTag", FSlice({ 1, 1, 1 }, { 1, 1 }, { 1, 1 }));
+}
+
+void UCloudCache::StartRecording()
+{
+	Recorder = MakeUnique<FSliceRequestRecorder>();
+}
+
+bool UCloudCache::StopRecording(const FString& FileName)
+{
+	if (!Recorder)
+	{
+		LOG_ERROR("Recording is not started");
+		return false;
+	}
+
+	const TUniquePtr<FSliceRequestRecorder> FinishedRecorder = MoveTemp(Recorder);
+	return FinishedRecorder->GetTrace().WriteToFile(FileName);
+}
+
+bool UCloudCache::IsRecording() const
+{
+	return Recorder.IsValid();
+}
+
+FSliceRequestRecorder* UCloudCache::GetRecorder() const
+{
+	return Recorder.Get();
+}
+
+void UCloudCache::BeginDestroy()
+{
+	ResetTiers();
+	IFileManager::Get().DeleteDirectory(*GetSpillDirectory(), false, true);
+	Super::BeginDestroy();
 }
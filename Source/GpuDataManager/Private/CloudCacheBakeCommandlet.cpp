@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CloudCacheBakeCommandlet.h"
+#include "ActorSlicer.h"
+#include "CloudCache.h"
+#include "Engine/World.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "UObject/Package.h"
+
+#define LOG_ERROR(ErrorText) UE_LOG(LogTemp, Warning, TEXT("CloudCacheBake %s: %s"), *FString(__func__), *FString(ErrorText));
+
+namespace
+{
+	TArray<FString> FindProjectMaps()
+	{
+		TArray<FString> MapFiles;
+		FPackageName::FindPackagesInDirectory(MapFiles, FPaths::ProjectContentDir());
+
+		TArray<FString> Maps;
+		for (const FString& File : MapFiles)
+		{
+			FString PackageName;
+			if (FPaths::GetExtension(File, true) == FPackageName::GetMapPackageExtension() &&
+				FPackageName::TryConvertFilenameToLongPackageName(File, PackageName))
+			{
+				Maps.Add(PackageName);
+			}
+		}
+		return Maps;
+	}
+
+	UWorld* LoadWorld(const FString& MapName)
+	{
+		UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+		UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+		if (!World)
+		{
+			return nullptr;
+		}
+
+		// Slicer traces need collision, nothing else
+		World->AddToRoot();
+		World->WorldType = EWorldType::Editor;
+		if (!World->bIsWorldInitialized)
+		{
+			World->InitWorld(UWorld::InitializationValues()
+				.InitializeScenes(false)
+				.AllowAudioPlayback(false)
+				.RequiresHitProxies(false)
+				.CreatePhysicsScene(true)
+				.CreateNavigation(false)
+				.CreateAISystem(false)
+				.ShouldSimulatePhysics(false)
+				.EnableTraceCollision(true)
+				.SetTransactional(false)
+				.CreateFXSystem(false));
+		}
+		World->UpdateWorldComponents(true, false);
+		return World;
+	}
+
+	void UnloadWorld(UWorld* World)
+	{
+		World->CleanupWorld();
+		World->RemoveFromRoot();
+		CollectGarbage(RF_NoFlags);
+	}
+}
+
+UCloudCacheBakeCommandlet::UCloudCacheBakeCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCloudCacheBakeCommandlet::Main(const FString& Params)
+{
+	FString MapsParam;
+	TArray<FString> Maps;
+	if (FParse::Value(*Params, TEXT("Maps="), MapsParam))
+	{
+		MapsParam.ParseIntoArray(Maps, TEXT("+"));
+	}
+	else
+	{
+		Maps = FindProjectMaps();
+	}
+
+	FString OutputFileName = UCloudCache::GetBakedFileName();
+	FParse::Value(*Params, TEXT("Output="), OutputFileName);
+
+	UCloudCache* BakedCache = NewObject<UCloudCache>();
+	BakedCache->AddToRoot();
+
+	int32 BakedSlicers = 0;
+	for (const FString& MapName : Maps)
+	{
+		UWorld* World = LoadWorld(MapName);
+		if (!World)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("CloudCacheBake: can't load map %s"), *MapName);
+			continue;
+		}
+
+		for (const ULevel* Level : World->GetLevels())
+		{
+			for (const AActor* Actor : Level->Actors)
+			{
+				if (!Actor)
+				{
+					continue;
+				}
+				TInlineComponentArray<UActorSlicer*> Slicers(Actor);
+				for (UActorSlicer* Slicer : Slicers)
+				{
+					if (Slicer->Bake(BakedCache))
+					{
+						UE_LOG(LogTemp, Display, TEXT("CloudCacheBake: baked %s in %s"), *Slicer->BakeSettings.CloudCacheTag.ToString(), *MapName);
+						++BakedSlicers;
+					}
+				}
+			}
+		}
+
+		UnloadWorld(World);
+	}
+
+	const bool Saved = BakedCache->SaveBinary(OutputFileName);
+	BakedCache->RemoveFromRoot();
+	if (!Saved)
+	{
+		LOG_ERROR("Can't write baked cache");
+		return 1;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("CloudCacheBake: %d slicers, %d clouds, %d slices written to %s"),
+		BakedSlicers, BakedCache->GetUniqueCloudCount(), BakedCache->GetUniqueSliceCount(), *OutputFileName);
+	return 0;
+}
@@ -0,0 +1,201 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CloudCacheReplayCommandlet.h"
+#include "ActorSlicer.h"
+#include "CloudCache.h"
+#include "SliceRequestTrace.h"
+#include "Dom/JsonObject.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+#define LOG_ERROR(ErrorText) UE_LOG(LogTemp, Warning, TEXT("CloudCacheReplay %s: %s"), *FString(__func__), *FString(ErrorText));
+
+namespace
+{
+	struct FReplayKindStats
+	{
+		TArray<float> LatenciesMs;
+		TArray<float> RecordedLatenciesMs;
+		int32 Hits = 0;
+		int32 RecordedHits = 0;
+
+		int32 Num() const { return LatenciesMs.Num(); }
+		double GetHitRate() const { return Num() > 0 ? static_cast<double>(Hits) / Num() : 0; }
+		double GetRecordedHitRate() const { return Num() > 0 ? static_cast<double>(RecordedHits) / Num() : 0; }
+	};
+
+	// Nearest-rank percentile, Values are sorted
+	float GetPercentile(const TArray<float>& Values, double Percent)
+	{
+		if (Values.Num() == 0)
+		{
+			return 0.f;
+		}
+		const int32 Rank = FMath::CeilToInt32(Percent / 100.0 * Values.Num());
+		return Values[FMath::Clamp(Rank - 1, 0, Values.Num() - 1)];
+	}
+
+	bool ReplayRequest(UCloudCache* Cache, UActorSlicer* Slicer, const FSliceRequestRecord& Record)
+	{
+		bool Success = false;
+		switch (Record.Kind)
+		{
+		case ESliceRequestKind::CalculateOrLoadSlice:
+			Slicer->SetCachePointer(Cache, Record.CloudTag);
+			Slicer->CalculateOrLoadSliceOnPlane(FVector(Record.PlaneOrigin), FRotator(Record.PlaneRotation),
+				FVector(Record.PointCloudExtent), FRotator(Record.PointCloudRotation), FVector(Record.PointCloudOrigin),
+				FVector2D(Record.ImagePhysicalSize), Record.TargetImageSize, Record.SliceTag, Success);
+			break;
+		case ESliceRequestKind::GetSlice:
+			Cache->GetSlice(Record.CloudTag, Record.SliceTag, Success);
+			break;
+		case ESliceRequestKind::FindSlice:
+			Success = Cache->FindSlice(Record.CloudTag, Record.SliceTag) != nullptr;
+			break;
+		case ESliceRequestKind::GetSliceFromStack:
+			Cache->GetSliceFromStack(Record.CloudTag, Record.SliceTag, Record.StackIndex, Success);
+			break;
+		case ESliceRequestKind::GetCloud:
+			Cache->GetCloud(Record.CloudTag, Success);
+			break;
+		case ESliceRequestKind::GetCloudWithSlices:
+			Cache->GetCloudWithSlices(Record.CloudTag, Success);
+			break;
+		default:
+			break;
+		}
+		return Success;
+	}
+
+	TSharedRef<FJsonObject> ToJsonObject(const FReplayKindStats& Stats)
+	{
+		const TSharedRef<FJsonObject> Object = MakeShared<FJsonObject>();
+		Object->SetNumberField(TEXT("Count"), Stats.Num());
+		Object->SetNumberField(TEXT("HitRate"), Stats.GetHitRate());
+		Object->SetNumberField(TEXT("RecordedHitRate"), Stats.GetRecordedHitRate());
+		for (const double Percent : { 50.0, 90.0, 99.0, 100.0 })
+		{
+			const FString Suffix = Percent < 100.0 ? FString::Printf(TEXT("P%.0fMs"), Percent) : FString(TEXT("MaxMs"));
+			Object->SetNumberField(Suffix, GetPercentile(Stats.LatenciesMs, Percent));
+			Object->SetNumberField(TEXT("Recorded") + Suffix, GetPercentile(Stats.RecordedLatenciesMs, Percent));
+		}
+		return Object;
+	}
+}
+
+UCloudCacheReplayCommandlet::UCloudCacheReplayCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCloudCacheReplayCommandlet::Main(const FString& Params)
+{
+	FString TraceFileName;
+	if (!FParse::Value(*Params, TEXT("Trace="), TraceFileName))
+	{
+		LOG_ERROR("-Trace= is required");
+		return 1;
+	}
+	FString CacheFileName = UCloudCache::GetBakedFileName();
+	FParse::Value(*Params, TEXT("Cache="), CacheFileName);
+	int64 RamBudget = 0;
+	FParse::Value(*Params, TEXT("RamBudget="), RamBudget);
+	FString OutputFileName;
+	FParse::Value(*Params, TEXT("Output="), OutputFileName);
+
+	const TOptional<FSliceRequestTrace> Trace = FSliceRequestTrace::ReadFromFile(TraceFileName);
+	if (!Trace)
+	{
+		LOG_ERROR("Can't read trace");
+		return 1;
+	}
+
+	UCloudCache* Cache = NewObject<UCloudCache>();
+	Cache->AddToRoot();
+	Cache->SetRamBudget(RamBudget);
+	if (!Cache->LoadBinary(CacheFileName))
+	{
+		LOG_ERROR("Can't load cache");
+		Cache->RemoveFromRoot();
+		return 1;
+	}
+
+	// Slicing needs only the cache, the slicer does not have to be registered in a world
+	UActorSlicer* Slicer = NewObject<UActorSlicer>();
+	Slicer->AddToRoot();
+
+	TArray<FReplayKindStats> KindStats;
+	KindStats.SetNum(static_cast<int32>(ESliceRequestKind::Num));
+	FReplayKindStats TotalStats;
+	for (const FSliceRequestRecord& Record : Trace->Records)
+	{
+		const double Begin = FPlatformTime::Seconds();
+		const bool Hit = ReplayRequest(Cache, Slicer, Record);
+		const float LatencyMs = static_cast<float>((FPlatformTime::Seconds() - Begin) * 1000.0);
+
+		for (FReplayKindStats* Stats : { &KindStats[static_cast<int32>(Record.Kind)], &TotalStats })
+		{
+			Stats->LatenciesMs.Add(LatencyMs);
+			Stats->RecordedLatenciesMs.Add(Record.LatencyMs);
+			Stats->Hits += Hit;
+			Stats->RecordedHits += Record.Hit;
+		}
+	}
+
+	const FCloudCacheStats CacheStats = Cache->GetStats();
+	Slicer->RemoveFromRoot();
+	Cache->RemoveFromRoot();
+
+	const TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	const TSharedRef<FJsonObject> JsonKinds = MakeShared<FJsonObject>();
+	auto Report = [](const TCHAR* Name, FReplayKindStats& Stats)
+	{
+		Stats.LatenciesMs.Sort();
+		Stats.RecordedLatenciesMs.Sort();
+		UE_LOG(LogTemp, Display,
+			TEXT("CloudCacheReplay: %-20s %6d requests, hit rate %5.1f%% (recorded %5.1f%%), p50 %.3f p90 %.3f p99 %.3f max %.3f ms (recorded p50 %.3f p99 %.3f ms)"),
+			Name, Stats.Num(), Stats.GetHitRate() * 100.0, Stats.GetRecordedHitRate() * 100.0,
+			GetPercentile(Stats.LatenciesMs, 50), GetPercentile(Stats.LatenciesMs, 90),
+			GetPercentile(Stats.LatenciesMs, 99), GetPercentile(Stats.LatenciesMs, 100),
+			GetPercentile(Stats.RecordedLatenciesMs, 50), GetPercentile(Stats.RecordedLatenciesMs, 99));
+	};
+	for (int32 Kind = 0; Kind < KindStats.Num(); ++Kind)
+	{
+		if (KindStats[Kind].Num() > 0)
+		{
+			const TCHAR* Name = LexToString(static_cast<ESliceRequestKind>(Kind));
+			Report(Name, KindStats[Kind]);
+			JsonKinds->SetObjectField(Name, ToJsonObject(KindStats[Kind]));
+		}
+	}
+	Report(TEXT("Total"), TotalStats);
+	UE_LOG(LogTemp, Display, TEXT("CloudCacheReplay: %d spill faults, average %.3f ms, max %.3f ms"),
+		CacheStats.FaultCount, CacheStats.AverageFaultLatencyMs, CacheStats.MaxFaultLatencyMs);
+
+	if (OutputFileName.IsEmpty())
+	{
+		return 0;
+	}
+
+	Root->SetObjectField(TEXT("Kinds"), JsonKinds);
+	Root->SetObjectField(TEXT("Total"), ToJsonObject(TotalStats));
+	Root->SetStringField(TEXT("Trace"), TraceFileName);
+	Root->SetStringField(TEXT("Cache"), CacheFileName);
+	Root->SetNumberField(TEXT("RamBudget"), RamBudget);
+	Root->SetNumberField(TEXT("FaultCount"), CacheStats.FaultCount);
+	Root->SetNumberField(TEXT("MaxFaultLatencyMs"), CacheStats.MaxFaultLatencyMs);
+
+	FString Json;
+	FJsonSerializer::Serialize(Root, TJsonWriterFactory<>::Create(&Json));
+	if (!FFileHelper::SaveStringToFile(Json, *OutputFileName))
+	{
+		LOG_ERROR("Can't write report");
+		return 1;
+	}
+	return 0;
+}
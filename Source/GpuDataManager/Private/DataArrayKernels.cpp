@@ -0,0 +1,366 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DataArrayKernels.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	// Below this many destination texels resampling stays on the calling thread
+	constexpr int32 ParallelResampleThreshold = 128 * 128;
+
+	EParallelForFlags GetResampleFlags(FIntPoint DestinationSize)
+	{
+		return DestinationSize.X * DestinationSize.Y < ParallelResampleThreshold
+			? EParallelForFlags::ForceSingleThread
+			: EParallelForFlags::None;
+	}
+
+	// Source range [Begin, End) covered by destination texel Index, at least one texel wide
+	void GetBoxFootprints(int32 SourceSize, int32 DestinationSize, TArray<int32>& OutBegin, TArray<int32>& OutEnd)
+	{
+		OutBegin.SetNumUninitialized(DestinationSize);
+		OutEnd.SetNumUninitialized(DestinationSize);
+		for (int32 Index = 0; Index < DestinationSize; ++Index)
+		{
+			const int32 Begin = FMath::Min(static_cast<int32>(static_cast<int64>(Index) * SourceSize / DestinationSize), SourceSize - 1);
+			const int32 End = static_cast<int32>(static_cast<int64>(Index + 1) * SourceSize / DestinationSize);
+			OutBegin[Index] = Begin;
+			OutEnd[Index] = FMath::Max(End, Begin + 1);
+		}
+	}
+
+	// Texel-center aligned sample positions: lower source texel and weight of the upper one
+	void GetBilinearTaps(int32 SourceSize, int32 DestinationSize, TArray<int32>& OutLower, TArray<float>& OutWeight)
+	{
+		OutLower.SetNumUninitialized(DestinationSize);
+		OutWeight.SetNumUninitialized(DestinationSize);
+		const float Step = static_cast<float>(SourceSize) / DestinationSize;
+		for (int32 Index = 0; Index < DestinationSize; ++Index)
+		{
+			const float Position = FMath::Clamp((Index + 0.5f) * Step - 0.5f, 0.f, static_cast<float>(SourceSize - 1));
+			const int32 Lower = FMath::Min(FMath::FloorToInt32(Position), FMath::Max(SourceSize - 2, 0));
+			OutLower[Index] = Lower;
+			OutWeight[Index] = SourceSize > 1 ? Position - Lower : 0.f;
+		}
+	}
+
+	// Clamps to [0, 1] and scales so that truncation in VectorStoreByte4 rounds to nearest
+	FORCEINLINE VectorRegister4Float ToUnorm8Range(const VectorRegister4Float& Value)
+	{
+		const VectorRegister4Float Clamped = VectorMin(VectorMax(Value, GlobalVectorConstants::FloatZero),
+			GlobalVectorConstants::FloatOne);
+		return VectorMultiplyAdd(Clamped, VectorSetFloat1(255.f), VectorSetFloat1(0.5f));
+	}
+
+	// Texels PackChannelsToBGRA8 packs per block, missing channels read these blocks
+	constexpr int32 PackBlockSize = 256;
+	struct FConstantChannelBlocks
+	{
+		FConstantChannelBlocks()
+		{
+			for (float& Value : Ones)
+			{
+				Value = 1.f;
+			}
+		}
+
+		alignas(16) float Zeros[PackBlockSize] {};
+		alignas(16) float Ones[PackBlockSize];
+	};
+	const FConstantChannelBlocks ConstantChannelBlocks;
+}
+
+void FDataArrayKernels::QuantizeToUnorm8(const float* Source, int32 Count, uint8* Destination)
+{
+	int32 Index = 0;
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		VectorStoreByte4(ToUnorm8Range(VectorLoad(Source + Index)), Destination + Index);
+	}
+	for (; Index < Count; ++Index)
+	{
+		Destination[Index] = static_cast<uint8>(FMath::Clamp(Source[Index], 0.f, 1.f) * 255.f + 0.5f);
+	}
+}
+
+void FDataArrayKernels::ConvertToHalf(const float* Source, int32 Count, uint16* Destination)
+{
+	int32 Index = 0;
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		FPlatformMath::VectorStoreHalf(Destination + Index, Source + Index);
+	}
+	for (; Index < Count; ++Index)
+	{
+		FPlatformMath::StoreHalf(Destination + Index, Source[Index]);
+	}
+}
+
+void FDataArrayKernels::PackChannelsToBGRA8(const float* R, const float* G, const float* B, const float* A,
+	int32 Count, uint8* Destination)
+{
+	// Null channels read a constant block instead, so the loop has no per-texel channel checks
+	for (int32 Begin = 0; Begin < Count; Begin += PackBlockSize)
+	{
+		const int32 Num = FMath::Min(PackBlockSize, Count - Begin);
+		const float* BlockR = R ? R + Begin : ConstantChannelBlocks.Zeros;
+		const float* BlockG = G ? G + Begin : ConstantChannelBlocks.Zeros;
+		const float* BlockB = B ? B + Begin : ConstantChannelBlocks.Zeros;
+		const float* BlockA = A ? A + Begin : ConstantChannelBlocks.Ones;
+		uint8* BlockDestination = Destination + Begin * 4;
+
+		// Four texels per iteration, channel bytes are shifted into BGRA order of little endian uint32 texels
+		int32 Index = 0;
+		for (; Index + 4 <= Num; Index += 4)
+		{
+			const VectorRegister4Int BlueBytes = VectorFloatToInt(ToUnorm8Range(VectorLoad(BlockB + Index)));
+			const VectorRegister4Int GreenBytes = VectorFloatToInt(ToUnorm8Range(VectorLoad(BlockG + Index)));
+			const VectorRegister4Int RedBytes = VectorFloatToInt(ToUnorm8Range(VectorLoad(BlockR + Index)));
+			const VectorRegister4Int AlphaBytes = VectorFloatToInt(ToUnorm8Range(VectorLoad(BlockA + Index)));
+			const VectorRegister4Int Texels = VectorIntOr(
+				VectorIntOr(BlueBytes, VectorShiftLeftImm(GreenBytes, 8)),
+				VectorIntOr(VectorShiftLeftImm(RedBytes, 16), VectorShiftLeftImm(AlphaBytes, 24)));
+			VectorIntStore(Texels, BlockDestination + Index * 4);
+		}
+		for (; Index < Num; ++Index)
+		{
+			const VectorRegister4Float Texel = VectorSet(BlockB[Index], BlockG[Index], BlockR[Index], BlockA[Index]);
+			VectorStoreByte4(ToUnorm8Range(Texel), BlockDestination + Index * 4);
+		}
+	}
+}
+
+void FDataArrayKernels::ApplyTransferFunction(const float* Source, int32 Count, float Scale, float Bias,
+	const FColor* Lut, FColor* Destination)
+{
+	const VectorRegister4Float ScaleVector = VectorSetFloat1(Scale);
+	const VectorRegister4Float BiasVector = VectorSetFloat1(Bias);
+	const VectorRegister4Float MaxIndex = VectorSetFloat1(255.f);
+
+	int32 Index = 0;
+	alignas(16) int32 LutIndices[4];
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		const VectorRegister4Float Scaled = VectorMultiplyAdd(VectorLoad(Source + Index), ScaleVector, BiasVector);
+		const VectorRegister4Float Clamped = VectorMin(VectorMax(Scaled, GlobalVectorConstants::FloatZero), MaxIndex);
+		VectorIntStoreAligned(VectorFloatToInt(Clamped), LutIndices);
+		Destination[Index + 0] = Lut[LutIndices[0]];
+		Destination[Index + 1] = Lut[LutIndices[1]];
+		Destination[Index + 2] = Lut[LutIndices[2]];
+		Destination[Index + 3] = Lut[LutIndices[3]];
+	}
+	for (; Index < Count; ++Index)
+	{
+		// Negated comparison maps NaN to index 0
+		const float Scaled = Source[Index] * Scale + Bias;
+		Destination[Index] = Lut[!(Scaled > 0.f) ? 0 : static_cast<int32>(FMath::Min(Scaled, 255.f))];
+	}
+}
+
+void FDataArrayKernels::ReduceMinMax(const float* Source, int32 Count, float& InOutMin, float& InOutMax)
+{
+	VectorRegister4Float MinVector = VectorSetFloat1(InOutMin);
+	VectorRegister4Float MaxVector = VectorSetFloat1(InOutMax);
+	int32 Index = 0;
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		const VectorRegister4Float Value = VectorLoad(Source + Index);
+		MinVector = VectorMin(MinVector, Value);
+		MaxVector = VectorMax(MaxVector, Value);
+	}
+
+	alignas(16) float Lanes[4];
+	VectorStoreAligned(MinVector, Lanes);
+	InOutMin = FMath::Min(FMath::Min(Lanes[0], Lanes[1]), FMath::Min(Lanes[2], Lanes[3]));
+	VectorStoreAligned(MaxVector, Lanes);
+	InOutMax = FMath::Max(FMath::Max(Lanes[0], Lanes[1]), FMath::Max(Lanes[2], Lanes[3]));
+	for (; Index < Count; ++Index)
+	{
+		InOutMin = FMath::Min(InOutMin, Source[Index]);
+		InOutMax = FMath::Max(InOutMax, Source[Index]);
+	}
+}
+
+void FDataArrayKernels::ReduceMinMax(const FVector3f* Source, int32 Count, FVector3f& InOutMin, FVector3f& InOutMax)
+{
+	// Four vectors are three registers with lanes XYZX, YZXY, ZXYZ
+	const float* Floats = &Source[0].X;
+	VectorRegister4Float Min[3] = {
+		VectorSet(InOutMin.X, InOutMin.Y, InOutMin.Z, InOutMin.X),
+		VectorSet(InOutMin.Y, InOutMin.Z, InOutMin.X, InOutMin.Y),
+		VectorSet(InOutMin.Z, InOutMin.X, InOutMin.Y, InOutMin.Z) };
+	VectorRegister4Float Max[3] = {
+		VectorSet(InOutMax.X, InOutMax.Y, InOutMax.Z, InOutMax.X),
+		VectorSet(InOutMax.Y, InOutMax.Z, InOutMax.X, InOutMax.Y),
+		VectorSet(InOutMax.Z, InOutMax.X, InOutMax.Y, InOutMax.Z) };
+	int32 Index = 0;
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		for (int32 Register = 0; Register < 3; ++Register)
+		{
+			const VectorRegister4Float Value = VectorLoad(Floats + Index * 3 + Register * 4);
+			Min[Register] = VectorMin(Min[Register], Value);
+			Max[Register] = VectorMax(Max[Register], Value);
+		}
+	}
+
+	alignas(16) float Lanes[3][4];
+	for (int32 Register = 0; Register < 3; ++Register)
+	{
+		VectorStoreAligned(Min[Register], Lanes[Register]);
+	}
+	InOutMin = FVector3f(
+		FMath::Min(FMath::Min(Lanes[0][0], Lanes[0][3]), FMath::Min(Lanes[1][2], Lanes[2][1])),
+		FMath::Min(FMath::Min(Lanes[0][1], Lanes[1][0]), FMath::Min(Lanes[1][3], Lanes[2][2])),
+		FMath::Min(FMath::Min(Lanes[0][2], Lanes[1][1]), FMath::Min(Lanes[2][0], Lanes[2][3])));
+	for (int32 Register = 0; Register < 3; ++Register)
+	{
+		VectorStoreAligned(Max[Register], Lanes[Register]);
+	}
+	InOutMax = FVector3f(
+		FMath::Max(FMath::Max(Lanes[0][0], Lanes[0][3]), FMath::Max(Lanes[1][2], Lanes[2][1])),
+		FMath::Max(FMath::Max(Lanes[0][1], Lanes[1][0]), FMath::Max(Lanes[1][3], Lanes[2][2])),
+		FMath::Max(FMath::Max(Lanes[0][2], Lanes[1][1]), FMath::Max(Lanes[2][0], Lanes[2][3])));
+
+	for (; Index < Count; ++Index)
+	{
+		InOutMin = InOutMin.ComponentMin(Source[Index]);
+		InOutMax = InOutMax.ComponentMax(Source[Index]);
+	}
+}
+
+void FDataArrayKernels::ScaleBias(float* Data, int32 Count, float Scale, float Bias)
+{
+	const VectorRegister4Float ScaleVector = VectorSetFloat1(Scale);
+	const VectorRegister4Float BiasVector = VectorSetFloat1(Bias);
+	int32 Index = 0;
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		VectorStore(VectorMultiplyAdd(VectorLoad(Data + Index), ScaleVector, BiasVector), Data + Index);
+	}
+	for (; Index < Count; ++Index)
+	{
+		Data[Index] = Data[Index] * Scale + Bias;
+	}
+}
+
+void FDataArrayKernels::ScaleBias(FVector3f* Data, int32 Count, const FVector3f& Scale, const FVector3f& Bias)
+{
+	float* Floats = &Data[0].X;
+	const VectorRegister4Float ScaleVectors[3] = {
+		VectorSet(Scale.X, Scale.Y, Scale.Z, Scale.X),
+		VectorSet(Scale.Y, Scale.Z, Scale.X, Scale.Y),
+		VectorSet(Scale.Z, Scale.X, Scale.Y, Scale.Z) };
+	const VectorRegister4Float BiasVectors[3] = {
+		VectorSet(Bias.X, Bias.Y, Bias.Z, Bias.X),
+		VectorSet(Bias.Y, Bias.Z, Bias.X, Bias.Y),
+		VectorSet(Bias.Z, Bias.X, Bias.Y, Bias.Z) };
+	int32 Index = 0;
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		for (int32 Register = 0; Register < 3; ++Register)
+		{
+			float* Pointer = Floats + Index * 3 + Register * 4;
+			VectorStore(VectorMultiplyAdd(VectorLoad(Pointer), ScaleVectors[Register], BiasVectors[Register]), Pointer);
+		}
+	}
+	for (; Index < Count; ++Index)
+	{
+		Data[Index] = Data[Index] * Scale + Bias;
+	}
+}
+
+float FDataArrayKernels::GetNormalizeScale(float Range)
+{
+	return Range > UE_SMALL_NUMBER ? 1.f / Range : 0.f;
+}
+
+FVector3f FDataArrayKernels::GetNormalizeScale(const FVector3f& Range)
+{
+	return FVector3f(GetNormalizeScale(Range.X), GetNormalizeScale(Range.Y), GetNormalizeScale(Range.Z));
+}
+
+void FDataArrayKernels::ResampleBox(const float* Source, FIntPoint SourceSize, float* Destination,
+	FIntPoint DestinationSize)
+{
+	if (SourceSize.X <= 0 || SourceSize.Y <= 0 || DestinationSize.X <= 0 || DestinationSize.Y <= 0)
+	{
+		return;
+	}
+
+	TArray<int32> ColumnBegin, ColumnEnd, RowBegin, RowEnd;
+	GetBoxFootprints(SourceSize.X, DestinationSize.X, ColumnBegin, ColumnEnd);
+	GetBoxFootprints(SourceSize.Y, DestinationSize.Y, RowBegin, RowEnd);
+
+	ParallelFor(DestinationSize.Y, [&](int32 Y)
+	{
+		float* DestinationRow = Destination + static_cast<int64>(Y) * DestinationSize.X;
+		for (int32 X = 0; X < DestinationSize.X; ++X)
+		{
+			float Sum = 0.f;
+			for (int32 SourceY = RowBegin[Y]; SourceY < RowEnd[Y]; ++SourceY)
+			{
+				const float* SourceRow = Source + static_cast<int64>(SourceY) * SourceSize.X;
+				for (int32 SourceX = ColumnBegin[X]; SourceX < ColumnEnd[X]; ++SourceX)
+				{
+					Sum += SourceRow[SourceX];
+				}
+			}
+			DestinationRow[X] = Sum / ((RowEnd[Y] - RowBegin[Y]) * (ColumnEnd[X] - ColumnBegin[X]));
+		}
+	}, GetResampleFlags(DestinationSize));
+}
+
+void FDataArrayKernels::ResampleBilinear(const float* Source, FIntPoint SourceSize, float* Destination,
+	FIntPoint DestinationSize)
+{
+	if (SourceSize.X <= 0 || SourceSize.Y <= 0 || DestinationSize.X <= 0 || DestinationSize.Y <= 0)
+	{
+		return;
+	}
+
+	TArray<int32> ColumnLower, RowLower;
+	TArray<float> ColumnWeight, RowWeight;
+	GetBilinearTaps(SourceSize.X, DestinationSize.X, ColumnLower, ColumnWeight);
+	GetBilinearTaps(SourceSize.Y, DestinationSize.Y, RowLower, RowWeight);
+	const int32 NextColumn = SourceSize.X > 1 ? 1 : 0;
+	const int32 NextRow = SourceSize.Y > 1 ? SourceSize.X : 0;
+
+	ParallelFor(DestinationSize.Y, [&](int32 Y)
+	{
+		const float* Top = Source + static_cast<int64>(RowLower[Y]) * SourceSize.X;
+		const float* Bottom = Top + NextRow;
+		const float WeightY = RowWeight[Y];
+		float* DestinationRow = Destination + static_cast<int64>(Y) * DestinationSize.X;
+		for (int32 X = 0; X < DestinationSize.X; ++X)
+		{
+			const int32 Lower = ColumnLower[X];
+			const float WeightX = ColumnWeight[X];
+			const float TopValue = FMath::Lerp(Top[Lower], Top[Lower + NextColumn], WeightX);
+			const float BottomValue = FMath::Lerp(Bottom[Lower], Bottom[Lower + NextColumn], WeightX);
+			DestinationRow[X] = FMath::Lerp(TopValue, BottomValue, WeightY);
+		}
+	}, GetResampleFlags(DestinationSize));
+}
+
+void FDataArrayKernels::ExpandToFloat4(const FVector3f* Source, int32 Count, FLinearColor* Destination)
+{
+	// Four vectors are three loads: X0 Y0 Z0 X1 | Y1 Z1 X2 Y2 | Z2 X3 Y3 Z3
+	int32 Index = 0;
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		const float* Floats = &Source[Index].X;
+		const VectorRegister4Float First = VectorLoad(Floats);
+		const VectorRegister4Float Second = VectorLoad(Floats + 4);
+		const VectorRegister4Float Third = VectorLoad(Floats + 8);
+		VectorStore(VectorSet_W1(First), &Destination[Index].R);
+		VectorStore(VectorSet_W1(VectorSwizzle(VectorShuffle(First, Second, 3, 3, 0, 1), 1, 2, 3, 3)), &Destination[Index + 1].R);
+		VectorStore(VectorSet_W1(VectorShuffle(Second, Third, 2, 3, 0, 0)), &Destination[Index + 2].R);
+		VectorStore(VectorSet_W1(VectorSwizzle(Third, 1, 2, 3, 3)), &Destination[Index + 3].R);
+	}
+	for (; Index < Count; ++Index)
+	{
+		VectorStore(VectorLoadFloat3_W1(&Source[Index].X), &Destination[Index].R);
+	}
+}
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Vectorized conversion of data array rows into packed texel formats, four elements per iteration
+class FDataArrayKernels
+{
+public:
+	// [0, 1] floats to unorm8 (PF_G8), out of range values are clamped
+	static void QuantizeToUnorm8(const float* Source, int32 Count, uint8* Destination);
+
+	// Floats to half floats (PF_R16F)
+	static void ConvertToHalf(const float* Source, int32 Count, uint16* Destination);
+
+	// Up to four [0, 1] channels to BGRA8 texels (PF_B8G8R8A8), null RGB channels are 0 and null alpha is 1
+	static void PackChannelsToBGRA8(const float* R, const float* G, const float* B, const float* A,
+		int32 Count, uint8* Destination);
+
+	// Window/level transfer function with colormap: Lut[clamp(Value * Scale + Bias, 0, 255)], Bias includes rounding
+	static void ApplyTransferFunction(const float* Source, int32 Count, float Scale, float Bias, const FColor* Lut,
+		FColor* Destination);
+
+	// Widens InOutMin/InOutMax by Count elements, vectors component-wise
+	static void ReduceMinMax(const float* Source, int32 Count, float& InOutMin, float& InOutMax);
+	static void ReduceMinMax(const FVector3f* Source, int32 Count, FVector3f& InOutMin, FVector3f& InOutMax);
+
+	// Data = Data * Scale + Bias in place, vectors component-wise
+	static void ScaleBias(float* Data, int32 Count, float Scale, float Bias);
+	static void ScaleBias(FVector3f* Data, int32 Count, const FVector3f& Scale, const FVector3f& Bias);
+
+	// Scale mapping a value range onto [0, 1], 0 for empty ranges
+	static float GetNormalizeScale(float Range);
+	static FVector3f GetNormalizeScale(const FVector3f& Range);
+
+	// Row-major image resampling, rows are processed in parallel for big images
+	// Box averages the source footprint of every destination texel (nearest when upscaling)
+	static void ResampleBox(const float* Source, FIntPoint SourceSize, float* Destination, FIntPoint DestinationSize);
+	static void ResampleBilinear(const float* Source, FIntPoint SourceSize, float* Destination, FIntPoint DestinationSize);
+
+	// Vectors to (X, Y, Z, 1) FLinearColor texels (PF_A32B32G32R32F)
+	static void ExpandToFloat4(const FVector3f* Source, int32 Count, FLinearColor* Destination);
+};
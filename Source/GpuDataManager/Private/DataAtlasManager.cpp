@@ -0,0 +1,198 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DataAtlasManager.h"
+#include "Engine/Canvas.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "DataTextureUploader.h"
+#include "GpuDataManagerStats.h"
+
+#define LOG_ERROR(ErrorText) UE_LOG(LogTemp, Warning, TEXT("DataAtlasManager %s: %s"), *FString(__func__), *FString(ErrorText));
+
+ADataAtlasManager::ADataAtlasManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+}
+
+bool ADataAtlasManager::Init()
+{
+	if (!RenderTargetHandler || TileSize <= 0 || TilesPerSide <= 0)
+	{
+		LOG_ERROR("Invalid parameters");
+		return false;
+	}
+
+	const auto WorldContext = GetWorld();
+	if (!WorldContext)
+	{
+		LOG_ERROR("Can't get world context");
+		return false;
+	}
+
+	const int32 AtlasSize = TileSize * TilesPerSide;
+	RenderTarget = UCanvasRenderTarget2D::CreateCanvasRenderTarget2D(WorldContext, RenderTargetHandler, AtlasSize, AtlasSize);
+	if (!RenderTarget)
+	{
+		LOG_ERROR("Can't create render target");
+		return false;
+	}
+	RenderTarget->OnCanvasRenderTargetUpdate.AddDynamic(this, &ADataAtlasManager::OnCanvasRenderTargetUpdate);
+
+	StagingTexture = nullptr;
+	Tiles.Reset();
+	Tiles.SetNum(TilesPerSide * TilesPerSide);
+	AcquiredTiles.Init(false, Tiles.Num());
+
+	RenderTarget->UpdateResourceImmediate(true);
+	return true;
+}
+
+FDataAtlasTile ADataAtlasManager::AcquireTile()
+{
+	const int32 Index = AcquiredTiles.Find(false);
+	if (Index == INDEX_NONE)
+	{
+		LOG_ERROR("Atlas is full");
+		return {};
+	}
+
+	AcquiredTiles[Index] = true;
+	if (!Tiles[Index])
+	{
+		Tiles[Index] = MakeUnique<TGenericDataArray<float>>(TileSize * TileSize, true, TileSize);
+	}
+
+	const int32 AtlasSize = TileSize * TilesPerSide;
+	const FIntPoint Origin = GetTileOrigin(Index);
+	FDataAtlasTile Tile;
+	Tile.Index = Index;
+	Tile.UVOffset = FVector2D(Origin) / AtlasSize;
+	Tile.UVScale = FVector2D(1.0 / TilesPerSide);
+	return Tile;
+}
+
+void ADataAtlasManager::ReleaseTile(const FDataAtlasTile& Tile)
+{
+	if (!IsAcquired(Tile))
+	{
+		return;
+	}
+
+	// Storage is kept for the next owner, empty array uploads zeroes over the old content
+	Tiles[Tile.Index]->SetArray(TConstArrayView<float>());
+	AcquiredTiles[Tile.Index] = false;
+}
+
+UMaterialInstanceDynamic* ADataAtlasManager::CreateTileMaterial(const FDataAtlasTile& Tile)
+{
+	if (!BaseMaterial || !RenderTarget || !IsAcquired(Tile))
+	{
+		LOG_ERROR("Atlas isn't initialised or tile isn't acquired");
+		return nullptr;
+	}
+
+	UMaterialInstanceDynamic* Material = UMaterialInstanceDynamic::Create(BaseMaterial, this);
+	if (!Material)
+	{
+		LOG_ERROR("Can't create material instance");
+		return nullptr;
+	}
+	Material->SetTextureParameterValue(TextureParameterName, RenderTarget);
+	Material->SetVectorParameterValue(TileUVParameterName,
+		FLinearColor(Tile.UVOffset.X, Tile.UVOffset.Y, Tile.UVScale.X, Tile.UVScale.Y));
+	return Material;
+}
+
+bool ADataAtlasManager::SetTileFloatArray(const FDataAtlasTile& Tile, const TArray<float>& Array)
+{
+	TGenericDataArray<float>* TileArray = GetTileArray(Tile);
+	return TileArray && TileArray->SetArray(Array);
+}
+
+TGenericDataArray<float>* ADataAtlasManager::GetTileArray(const FDataAtlasTile& Tile)
+{
+	return IsAcquired(Tile) ? Tiles[Tile.Index].Get() : nullptr;
+}
+
+void ADataAtlasManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+	Flush();
+}
+
+void ADataAtlasManager::Flush()
+{
+	if (!RenderTarget)
+	{
+		return;
+	}
+
+	const bool AnyDirty = StagingTexture == nullptr || Tiles.ContainsByPredicate(
+		[](const TUniquePtr<TGenericDataArray<float>>& Tile) { return Tile && Tile->IsDirty(); });
+	if (AnyDirty)
+	{
+		RenderTarget->UpdateResource();
+	}
+}
+
+void ADataAtlasManager::OnCanvasRenderTargetUpdate(UCanvas* Canvas, int32 Width, int32 Height)
+{
+	if (!Canvas)
+	{
+		LOG_ERROR("Canvas is null");
+		return;
+	}
+
+	GPUDATA_SCOPE(STAT_GpuData_TextureUpload, TextureUpload);
+	const int32 AtlasSize = TileSize * TilesPerSide;
+	UTexture2D* Texture = FDataTextureUploader::GetOrCreateTexture(StagingTexture, AtlasSize, AtlasSize, PF_R32_FLOAT);
+	if (!Texture)
+	{
+		LOG_ERROR("Can't create staging texture");
+		return;
+	}
+
+	// New texture has no content yet
+	const bool IsNewTexture = Texture != StagingTexture;
+	StagingTexture = Texture;
+
+	// Dirty regions of every tile go into one buffer and one region update
+	FDataTextureUpload& Upload = UploadRing.Acquire();
+	for (int32 Index = 0; Index < Tiles.Num(); ++Index)
+	{
+		TGenericDataArray<float>* Tile = Tiles[Index].Get();
+		if (!Tile)
+		{
+			continue;
+		}
+		if (IsNewTexture)
+		{
+			Tile->MarkAllDirty();
+		}
+		FDataTextureUploader::PackDirtyRegions(*Tile, AtlasSize, sizeof(float), GetTileOrigin(Index),
+			[](const float* Source, int32 Count, uint8* Destination)
+			{
+				FMemory::Memcpy(Destination, Source, Count * sizeof(float));
+			}, Upload);
+		Tile->ClearDirty();
+	}
+
+	FDataTextureUploader::UploadRegions(StagingTexture, Upload, sizeof(float));
+
+	FCanvasTileItem Item(FVector2D::ZeroVector, StagingTexture->GetResource(),
+		FVector2D(Width, Height), FLinearColor::White);
+	Item.BlendMode = SE_BLEND_Opaque;
+	Canvas->DrawItem(Item);
+
+	OnUpdate.Broadcast(Canvas, Width, Height);
+}
+
+bool ADataAtlasManager::IsAcquired(const FDataAtlasTile& Tile) const
+{
+	return AcquiredTiles.IsValidIndex(Tile.Index) && AcquiredTiles[Tile.Index];
+}
+
+FIntPoint ADataAtlasManager::GetTileOrigin(int32 Index) const
+{
+	return FIntPoint(Index % TilesPerSide, Index / TilesPerSide) * TileSize;
+}
@@ -3,9 +3,46 @@
 
 #include "DataManager.h"
 #include "Engine/Canvas.h"
+#include "DataTextureUploader.h"
+#include "DataArrayKernels.h"
+#include "Algo/AnyOf.h"
+#include "DataRenderTargetPool.h"
+#include "CloudCache.h"
+#include "GpuDataManagerStats.h"
 
 #define LOG_ERROR(ErrorText) UE_LOG(LogTemp, Warning, TEXT("GpuDataRenderer %s: %s"), *FString(__func__), *FString(ErrorText));
 
+void FDataTransferFunction::BakeLut(TArray<FColor>& OutLut) const
+{
+	OutLut.SetNumUninitialized(256);
+	const float Exponent = Gamma > 0.f ? Gamma : 1.f;
+	for (int32 Index = 0; Index < 256; ++Index)
+	{
+		const float Value = FMath::Pow(Index / 255.f, Exponent);
+
+		FLinearColor Color(Value, Value, Value);
+		if (Colormap.Num() == 1)
+		{
+			Color = Colormap[0];
+		}
+		else if (Colormap.Num() > 1)
+		{
+			const float Position = Value * (Colormap.Num() - 1);
+			const int32 Stop = FMath::Min(FMath::FloorToInt32(Position), Colormap.Num() - 2);
+			Color = FMath::Lerp(Colormap[Stop], Colormap[Stop + 1], Position - Stop);
+		}
+		// Data textures are linear
+		OutLut[Index] = Color.ToFColor(false);
+	}
+}
+
+void FDataTransferFunction::GetIndexTransform(float& OutScale, float& OutBias) const
+{
+	const float Width = FMath::Max(WindowWidth, UE_KINDA_SMALL_NUMBER);
+	OutScale = 255.f / Width;
+	OutBias = (Width * 0.5f - WindowLevel) * OutScale + 0.5f;
+}
+
 void ADataManager::OnCanvasRenderTargetUpdate(UCanvas* Canvas, int32 Width, int32 Height)
 {
 	if (!Canvas)
@@ -16,69 +53,340 @@ void ADataManager::OnCanvasRenderTargetUpdate(UCanvas* Canvas, int32 Width, int3
 
 	if (CurrentActiveArrayType.IsSet())
 	{
-		switch (CurrentActiveArrayType.GetValue())
+		if (!bUseBulkUpload || !UploadActiveArray(Canvas, Width, Height))
 		{
-		case EArrayTypes::Float:
-			// Transfer float array to Canvas
+			DrawActiveArrayTiles(Canvas);
+			// Tiles path consumed dirty regions, staging texture content is stale now
+			StagingTexture = nullptr;
+		}
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("GpuDataRenderer %hs: Broadcast update"), __func__);
+	OnUpdate.Broadcast(Canvas, Width, Height);
+}
+
+bool ADataManager::UploadActiveArray(UCanvas* Canvas, int32 Width, int32 Height)
+{
+	GPUDATA_SCOPE(STAT_GpuData_TextureUpload, TextureUpload);
+	const EArrayTypes ActiveType = CurrentActiveArrayType.GetValue();
+	EPixelFormat Format = PF_Unknown;
+	uint32 PixelBytes = 0;
+	switch (ActiveType)
+	{
+	case EArrayTypes::Float:
+		Format = PF_R32_FLOAT;
+		PixelBytes = sizeof(float);
+		break;
+	case EArrayTypes::FVector3f:
+		Format = PF_A32B32G32R32F;
+		PixelBytes = sizeof(FLinearColor);
+		break;
+	case EArrayTypes::FloatR8:
+		Format = PF_G8;
+		PixelBytes = sizeof(uint8);
+		break;
+	case EArrayTypes::FloatR16F:
+		Format = PF_R16F;
+		PixelBytes = sizeof(uint16);
+		break;
+	case EArrayTypes::PackedRGBA8:
+		Format = PF_B8G8R8A8;
+		PixelBytes = sizeof(FColor);
+		break;
+	default:
+		return false;
+	}
+
+	const bool UseTransferFunction = TransferFunction.bEnabled &&
+		(ActiveType == EArrayTypes::Float || ActiveType == EArrayTypes::FloatR8 || ActiveType == EArrayTypes::FloatR16F);
+	if (UseTransferFunction)
+	{
+		Format = PF_B8G8R8A8;
+		PixelBytes = sizeof(FColor);
+	}
+
+	TGenericDataArray<float>* FloatArray = nullptr;
+	TGenericDataArray<FVector3f>* Vector3fArray = nullptr;
+	switch (ActiveType)
+	{
+	case EArrayTypes::FVector3f:
+		Vector3fArray = GetActiveFVector3fArray();
+		if (!Vector3fArray)
+		{
+			return false;
+		}
+		break;
+	case EArrayTypes::PackedRGBA8:
+		if (!Algo::AnyOf(ChannelDataArrays))
+		{
+			return false;
+		}
+		break;
+	default:
+		FloatArray = GetActiveFloatArray();
+		if (!FloatArray)
+		{
+			return false;
+		}
+		break;
+	}
+
+	UTexture2D* Texture = FDataTextureUploader::GetOrCreateTexture(StagingTexture, TextureSize, TextureSize, Format);
+	if (!Texture)
+	{
+		LOG_ERROR("Can't create staging texture, fall back to canvas tiles");
+		return false;
+	}
+
+	// New texture has no content yet
+	const bool IsNewTexture = Texture != StagingTexture;
+	StagingTexture = Texture;
+	if (UseTransferFunction && RefreshTransferFunction())
+	{
+		FloatArray->MarkAllDirty();
+	}
+	if (IsNewTexture && FloatArray)
+	{
+		FloatArray->MarkAllDirty();
+	}
+	if (IsNewTexture && Vector3fArray)
+	{
+		Vector3fArray->MarkAllDirty();
+	}
+
+	FDataTextureUpload& Upload = UploadRing.Acquire();
+	if (UseTransferFunction)
+	{
+		// Colorized straight into the upload buffer
+		float Scale, Bias;
+		TransferFunction.GetIndexTransform(Scale, Bias);
+		const FColor* Lut = TransferLut.GetData();
+		FDataTextureUploader::PackDirtyRegions(*FloatArray, TextureSize, PixelBytes, FIntPoint::ZeroValue,
+			[Scale, Bias, Lut](const float* Source, int32 Count, uint8* Destination)
 			{
-				if (!FloatDataArray)
+				FDataArrayKernels::ApplyTransferFunction(Source, Count, Scale, Bias, Lut, reinterpret_cast<FColor*>(Destination));
+			}, Upload);
+	}
+	else
+	{
+		switch (ActiveType)
+		{
+		case EArrayTypes::Float:
+			FDataTextureUploader::PackDirtyRegions(*FloatArray, TextureSize, PixelBytes, FIntPoint::ZeroValue,
+				[](const float* Source, int32 Count, uint8* Destination)
 				{
-					LOG_ERROR("Float array is NULL, but CurrentActiveArrayType is float, skip array uploading");
-					UE_LOG(LogTemp, Log, TEXT("GpuDataRenderer %hs: Broadcast update"), __func__);
-					OnUpdate.Broadcast(Canvas, Width, Height);
-					return;
-				}
-				auto It = FloatDataArray->Begin();
-
-				while (!It.IsEnd())
+					FMemory::Memcpy(Destination, Source, Count * sizeof(float));
+				}, Upload);
+			break;
+		case EArrayTypes::FloatR8:
+			FDataTextureUploader::PackDirtyRegions(*FloatArray, TextureSize, PixelBytes, FIntPoint::ZeroValue,
+				[](const float* Source, int32 Count, uint8* Destination)
+				{
+					FDataArrayKernels::QuantizeToUnorm8(Source, Count, Destination);
+				}, Upload);
+			break;
+		case EArrayTypes::FloatR16F:
+			FDataTextureUploader::PackDirtyRegions(*FloatArray, TextureSize, PixelBytes, FIntPoint::ZeroValue,
+				[](const float* Source, int32 Count, uint8* Destination)
 				{
-					const float CurrentArrayValue = *(*It).GetValue();
-					const FLinearColor RenderColor {CurrentArrayValue, 0, 0};
-					const FVector2D PixelPos = ToImageCoord(It.GetPlainIndex());
+					FDataArrayKernels::ConvertToHalf(Source, Count, reinterpret_cast<uint16*>(Destination));
+				}, Upload);
+			break;
+		case EArrayTypes::FVector3f:
+			FDataTextureUploader::PackDirtyRegions(*Vector3fArray, TextureSize, PixelBytes, FIntPoint::ZeroValue,
+				[](const FVector3f* Source, int32 Count, uint8* Destination)
+				{
+					FDataArrayKernels::ExpandToFloat4(Source, Count, reinterpret_cast<FLinearColor*>(Destination));
+				}, Upload);
+			break;
+		case EArrayTypes::PackedRGBA8:
+			PackChannels(Upload, IsNewTexture);
+			break;
+		}
+	}
 
-					FCanvasTileItem Tile (PixelPos, FVector2D::UnitVector, RenderColor);
-					Tile.BlendMode = SE_BLEND_Opaque;
-					Canvas->DrawItem(Tile);
+	if (FloatArray)
+	{
+		FloatArray->ClearDirty();
+	}
+	if (Vector3fArray)
+	{
+		Vector3fArray->ClearDirty();
+	}
 
-					++It;
-				}
-				break;
+	FDataTextureUploader::UploadRegions(StagingTexture, Upload, PixelBytes);
+
+	FCanvasTileItem Tile(FVector2D::ZeroVector, StagingTexture->GetResource(),
+		FVector2D(Width, Height), FLinearColor::White);
+	Tile.BlendMode = SE_BLEND_Opaque;
+	Canvas->DrawItem(Tile);
+	return true;
+}
+
+bool ADataManager::RefreshTransferFunction()
+{
+	if (TransferLut.Num() == 256 && TransferFunction == BakedTransferFunction)
+	{
+		return false;
+	}
+
+	TransferFunction.BakeLut(TransferLut);
+	BakedTransferFunction = TransferFunction;
+	return true;
+}
+
+void ADataManager::PackChannels(FDataTextureUpload& Upload, bool ForceFull)
+{
+	// Channels are uploaded together as one full region whenever any of them changed
+	int32 Num = 0;
+	bool AnyDirty = ForceFull;
+	for (const TUniquePtr<TGenericDataArray<float>>& Channel : ChannelDataArrays)
+	{
+		if (Channel)
+		{
+			Num = FMath::Max(Num, Channel->GetArraySize());
+			AnyDirty |= Channel->IsDirty();
+		}
+	}
+	if (!AnyDirty)
+	{
+		return;
+	}
+
+	Upload.Regions.Add(FDataTextureUploader::MakeRowsRegion(TextureSize, TextureSize * TextureSize));
+	Upload.Pixels.SetNumZeroed(TextureSize * TextureSize * sizeof(FColor), EAllowShrinking::No);
+
+	// Rows are texture-wide, so the texture is one contiguous run; split it where a channel runs out of elements
+	int32 Begin = 0;
+	while (Begin < Num)
+	{
+		int32 End = Num;
+		const float* Sources[PackedChannelCount] {};
+		for (int32 Index = 0; Index < PackedChannelCount; ++Index)
+		{
+			const TGenericDataArray<float>* Channel = ChannelDataArrays[Index].Get();
+			if (Channel && Channel->GetArraySize() > Begin)
+			{
+				End = FMath::Min(End, Channel->GetArraySize());
+				Sources[Index] = Channel->GetData() + Begin;
 			}
-		case EArrayTypes::FVector3f:
-			// Transfer FVector2d array to canvas
+		}
+		FDataArrayKernels::PackChannelsToBGRA8(Sources[0], Sources[1], Sources[2], Sources[3],
+			End - Begin, Upload.Pixels.GetData() + Begin * sizeof(FColor));
+		Begin = End;
+	}
+
+	for (const TUniquePtr<TGenericDataArray<float>>& Channel : ChannelDataArrays)
+	{
+		if (Channel)
+		{
+			Channel->ClearDirty();
+		}
+	}
+}
+
+void ADataManager::DrawActiveArrayTiles(UCanvas* Canvas)
+{
+	switch (CurrentActiveArrayType.GetValue())
+	{
+	case EArrayTypes::Float:
+	case EArrayTypes::FloatR8:
+	case EArrayTypes::FloatR16F:
+		// Transfer float array to Canvas
+		{
+			TGenericDataArray<float>* FloatArray = GetActiveFloatArray();
+			if (!FloatArray)
 			{
-				if (!Vector3dDataArray)
+				LOG_ERROR("Float array is NULL, but CurrentActiveArrayType is float, skip array uploading");
+				return;
+			}
+			float Scale = 1, Bias = 0;
+			if (TransferFunction.bEnabled)
+			{
+				RefreshTransferFunction();
+				TransferFunction.GetIndexTransform(Scale, Bias);
+			}
+			FloatArray->ForEachElement([&](int32 Index, const float& CurrentArrayValue)
+			{
+				FLinearColor RenderColor {CurrentArrayValue, 0, 0};
+				if (TransferFunction.bEnabled)
 				{
-					LOG_ERROR("Vector3d array is NULL, but CurrentActiveArrayType is FVector3F, skip array uploading");
-					UE_LOG(LogTemp, Log, TEXT("GpuDataRenderer %hs: Broadcast update"), __func__);
-					OnUpdate.Broadcast(Canvas, Width, Height);
-					return;
+					FColor Color;
+					FDataArrayKernels::ApplyTransferFunction(&CurrentArrayValue, 1, Scale, Bias, TransferLut.GetData(), &Color);
+					RenderColor = Color.ReinterpretAsLinear();
 				}
-				
-				auto It = Vector3dDataArray->Begin();
+				const FVector2D PixelPos = ToImageCoord(Index);
+
+				FCanvasTileItem Tile (PixelPos, FVector2D::UnitVector, RenderColor);
+				Tile.BlendMode = SE_BLEND_Opaque;
+				Canvas->DrawItem(Tile);
+			});
+			FloatArray->ClearDirty();
+			break;
+		}
+	case EArrayTypes::FVector3f:
+		// Transfer FVector2d array to canvas
+		{
+			TGenericDataArray<FVector3f>* Vector3fArray = GetActiveFVector3fArray();
+			if (!Vector3fArray)
+			{
+				LOG_ERROR("Vector3d array is NULL, but CurrentActiveArrayType is FVector3F, skip array uploading");
+				return;
+			}
+			
+			Vector3fArray->ForEachElement([&](int32 Index, const FVector3f& CurrentArrayValue)
+			{
+				const FLinearColor RenderColor {
+					CurrentArrayValue.X,
+					CurrentArrayValue.Y,
+					CurrentArrayValue.Z};
+				const FVector2D PixelPos = ToImageCoord(Index);
+
+				FCanvasTileItem Tile (PixelPos, FVector2D::UnitVector, RenderColor);
+				Tile.BlendMode = SE_BLEND_Opaque;
+				Canvas->DrawItem(Tile);
+			});
+			Vector3fArray->ClearDirty();
+			break;
+		}
+	case EArrayTypes::PackedRGBA8:
+		// Transfer channel arrays to canvas
+		{
+			int32 Num = 0;
+			for (const TUniquePtr<TGenericDataArray<float>>& Channel : ChannelDataArrays)
+			{
+				Num = Channel ? FMath::Max(Num, Channel->GetArraySize()) : Num;
+			}
+
+			const auto GetChannelValue = [this](int32 Channel, int32 Index, float Default)
+			{
+				const TGenericDataArray<float>* ChannelArray = ChannelDataArrays[Channel].Get();
+				return ChannelArray && Index < ChannelArray->GetArraySize() ? ChannelArray->GetData()[Index] : Default;
+			};
+
+			for (int32 Index = 0; Index < Num; ++Index)
+			{
+				const FLinearColor RenderColor {
+					GetChannelValue(0, Index, 0),
+					GetChannelValue(1, Index, 0),
+					GetChannelValue(2, Index, 0),
+					GetChannelValue(3, Index, 1)};
 
-				while (!It.IsEnd())
+				FCanvasTileItem Tile (ToImageCoord(Index), FVector2D::UnitVector, RenderColor);
+				Tile.BlendMode = SE_BLEND_Opaque;
+				Canvas->DrawItem(Tile);
+			}
+
+			for (const TUniquePtr<TGenericDataArray<float>>& Channel : ChannelDataArrays)
+			{
+				if (Channel)
 				{
-					const FVector3f CurrentArrayValue = *(*It).GetValue();
-					const FLinearColor RenderColor {
-						CurrentArrayValue.X,
-						CurrentArrayValue.Y,
-						0};
-					const FVector2D PixelPos = ToImageCoord(It.GetPlainIndex());
-
-					FCanvasTileItem Tile (PixelPos, FVector2D::UnitVector, RenderColor);
-					Tile.BlendMode = SE_BLEND_Opaque;
-					Canvas->DrawItem(Tile);
-
-					++It;
+					Channel->ClearDirty();
 				}
-				break;
 			}
+			break;
 		}
 	}
-
-	UE_LOG(LogTemp, Log, TEXT("GpuDataRenderer %hs: Broadcast update"), __func__);
-	OnUpdate.Broadcast(Canvas, Width, Height);
 }
 
 UMaterialInstanceDynamic* ADataManager::Init()
@@ -105,14 +413,20 @@ UMaterialInstanceDynamic* ADataManager::Init()
 		return nullptr;
 	}
 
-	MaterialInstance = UMaterialInstanceDynamic::Create(BaseMaterial, this);
+	// Reinitialisation hands previous resources back before acquiring new ones
+	ReleasePooledResources();
+
+	UDataRenderTargetPool* Pool = WorldContext->GetSubsystem<UDataRenderTargetPool>();
+	MaterialInstance = Pool ? Pool->AcquireMaterial(BaseMaterial) : UMaterialInstanceDynamic::Create(BaseMaterial, this);
 	if (!MaterialInstance)
 	{
 		LOG_ERROR("Can't create material instance");
 		return nullptr;
 	}
 	
-	RenderTarget = UCanvasRenderTarget2D::CreateCanvasRenderTarget2D(WorldContext, RenderTargetHandler, TextureSize, TextureSize);
+	RenderTarget = Pool
+		? Pool->AcquireRenderTarget(RenderTargetHandler, TextureSize, TextureSize)
+		: UCanvasRenderTarget2D::CreateCanvasRenderTarget2D(WorldContext, RenderTargetHandler, TextureSize, TextureSize);
 	if (!RenderTarget)
 	{
 		LOG_ERROR("Can't create render target");
@@ -129,6 +443,37 @@ UMaterialInstanceDynamic* ADataManager::Init()
 	return MaterialInstance;
 }
 
+void ADataManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UnbindSlice();
+	ReleasePooledResources();
+	Super::EndPlay(EndPlayReason);
+}
+
+void ADataManager::ReleasePooledResources()
+{
+	const UWorld* World = GetWorld();
+	UDataRenderTargetPool* Pool = World ? World->GetSubsystem<UDataRenderTargetPool>() : nullptr;
+	if (Pool)
+	{
+		if (RenderTarget)
+		{
+			RenderTarget->OnCanvasRenderTargetUpdate.RemoveAll(this);
+			Pool->ReleaseRenderTarget(RenderTarget);
+		}
+		Pool->ReleaseMaterial(MaterialInstance);
+	}
+	else if (RenderTarget)
+	{
+		RenderTarget->OnCanvasRenderTargetUpdate.RemoveAll(this);
+	}
+
+	RenderTarget = nullptr;
+	MaterialInstance = nullptr;
+	// Staging content belongs to the released render target
+	StagingTexture = nullptr;
+}
+
 void ADataManager::Update()
 {
 	if (!RenderTarget)
@@ -152,7 +497,137 @@ void ADataManager::UpdateAsFVector3fArray()
 	Update();
 }
 
+void ADataManager::UpdateAsFloatArrayR8()
+{
+	CurrentActiveArrayType.Emplace(EArrayTypes::FloatR8);
+	Update();
+}
+
+void ADataManager::UpdateAsFloatArrayR16F()
+{
+	CurrentActiveArrayType.Emplace(EArrayTypes::FloatR16F);
+	Update();
+}
+
+void ADataManager::UpdateAsPackedChannels()
+{
+	CurrentActiveArrayType.Emplace(EArrayTypes::PackedRGBA8);
+	Update();
+}
+
 void ADataManager::UpdateWithNoSource()
 {
 	CurrentActiveArrayType = {};
 }
+
+bool ADataManager::UpdateIfPublished()
+{
+	if ((BufferedFloatDataArray && BufferedFloatDataArray->HasPublished()) ||
+		(BufferedVector3dDataArray && BufferedVector3dDataArray->HasPublished()))
+	{
+		Update();
+		return true;
+	}
+	return false;
+}
+
+bool ADataManager::SetSlice(const FSlice& Slice, ESliceResampleFilter Filter)
+{
+	if (Slice.Resolution.X <= 0 || Slice.Resolution.Y <= 0 || Slice.Data.Num() != Slice.Resolution.X * Slice.Resolution.Y)
+	{
+		LOG_ERROR("Slice resolution doesn't match its data");
+		return false;
+	}
+
+	TGenericDataArray<float>* FloatArray = GetOrCreateFloatArray();
+	const FIntPoint TextureResolution(TextureSize, TextureSize);
+	if (Slice.Resolution == TextureResolution)
+	{
+		FloatArray->SetArray(TConstArrayView<float>(Slice.Data));
+	}
+	else
+	{
+		// Resampled straight into the preallocated storage
+		const TArrayView<float> Target = FloatArray->GetWritableView(TextureSize * TextureSize);
+		if (Filter == ESliceResampleFilter::Box)
+		{
+			FDataArrayKernels::ResampleBox(Slice.Data.GetData(), Slice.Resolution, Target.GetData(), TextureResolution);
+		}
+		else
+		{
+			FDataArrayKernels::ResampleBilinear(Slice.Data.GetData(), Slice.Resolution, Target.GetData(), TextureResolution);
+		}
+	}
+
+	// Keep packed float format if one was chosen
+	if (!CurrentActiveArrayType.IsSet() || (CurrentActiveArrayType.GetValue() != EArrayTypes::FloatR8 &&
+		CurrentActiveArrayType.GetValue() != EArrayTypes::FloatR16F))
+	{
+		CurrentActiveArrayType.Emplace(EArrayTypes::Float);
+	}
+	Update();
+	return true;
+}
+
+bool ADataManager::BindSlice(UCloudCache* Cache, FName CloudTag, FName SliceTag, ESliceResampleFilter Filter)
+{
+	UnbindSlice();
+	if (!Cache)
+	{
+		LOG_ERROR("Cache is null");
+		return false;
+	}
+
+	BoundCache = Cache;
+	BoundCloudTag = CloudTag;
+	BoundSliceTag = SliceTag;
+	BoundFilter = Filter;
+	BoundSliceHandle = Cache->OnSliceChanged.AddUObject(this, &ADataManager::OnBoundSliceChanged);
+	return RefreshBoundSlice();
+}
+
+void ADataManager::UnbindSlice()
+{
+	if (UCloudCache* Cache = BoundCache.Get())
+	{
+		Cache->OnSliceChanged.Remove(BoundSliceHandle);
+	}
+	BoundCache.Reset();
+	BoundSliceHandle.Reset();
+}
+
+void ADataManager::OnBoundSliceChanged(FName CloudTag, FName SliceTag)
+{
+	if (CloudTag == BoundCloudTag && SliceTag == BoundSliceTag)
+	{
+		RefreshBoundSlice();
+	}
+}
+
+bool ADataManager::RefreshBoundSlice()
+{
+	UCloudCache* Cache = BoundCache.Get();
+	// Removed slice keeps showing its last content
+	const FSlice* Slice = Cache ? Cache->FindSlice(BoundCloudTag, BoundSliceTag) : nullptr;
+	return Slice && SetSlice(*Slice, BoundFilter);
+}
+
+TGenericDataArray<float>* ADataManager::GetActiveFloatArray()
+{
+	if (BufferedFloatDataArray)
+	{
+		BufferedFloatDataArray->Consume();
+		return &BufferedFloatDataArray->GetReadBuffer();
+	}
+	return FloatDataArray.Get();
+}
+
+TGenericDataArray<FVector3f>* ADataManager::GetActiveFVector3fArray()
+{
+	if (BufferedVector3dDataArray)
+	{
+		BufferedVector3dDataArray->Consume();
+		return &BufferedVector3dDataArray->GetReadBuffer();
+	}
+	return Vector3dDataArray.Get();
+}
@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DataRenderTargetPool.h"
+#include "Materials/MaterialInstanceDynamic.h"
+
+namespace
+{
+	ETextureRenderTargetFormat GetClassFormat(TSubclassOf<UCanvasRenderTarget2D> Class)
+	{
+		return Class ? Class->GetDefaultObject<UCanvasRenderTarget2D>()->RenderTargetFormat.GetValue() : RTF_RGBA16f;
+	}
+}
+
+UCanvasRenderTarget2D* UDataRenderTargetPool::AcquireRenderTarget(TSubclassOf<UCanvasRenderTarget2D> Class,
+	int32 SizeX, int32 SizeY)
+{
+	if (!Class)
+	{
+		return nullptr;
+	}
+
+	const ETextureRenderTargetFormat Format = GetClassFormat(Class);
+	// Most recently released first, it is the least likely to be trimmed soon
+	for (int32 Index = FreeRenderTargets.Num() - 1; Index >= 0; --Index)
+	{
+		const FPooledDataRenderTarget& Pooled = FreeRenderTargets[Index];
+		if (Pooled.RenderTarget && Pooled.Class == Class && Pooled.Format == Format &&
+			Pooled.RenderTarget->SizeX == SizeX && Pooled.RenderTarget->SizeY == SizeY)
+		{
+			UCanvasRenderTarget2D* RenderTarget = Pooled.RenderTarget;
+			FreeRenderTargets.RemoveAt(Index);
+			++Stats.Hits;
+			return RenderTarget;
+		}
+	}
+
+	++Stats.Misses;
+	return UCanvasRenderTarget2D::CreateCanvasRenderTarget2D(GetWorld(), Class, SizeX, SizeY);
+}
+
+void UDataRenderTargetPool::ReleaseRenderTarget(UCanvasRenderTarget2D* RenderTarget)
+{
+	if (!RenderTarget)
+	{
+		return;
+	}
+
+	// Previous owner must not receive updates of the next one
+	RenderTarget->OnCanvasRenderTargetUpdate.Clear();
+
+	FPooledDataRenderTarget& Pooled = FreeRenderTargets.AddDefaulted_GetRef();
+	Pooled.RenderTarget = RenderTarget;
+	Pooled.Class = RenderTarget->GetClass();
+	Pooled.Format = RenderTarget->RenderTargetFormat;
+	Pooled.ReleaseTime = FPlatformTime::Seconds();
+
+	// Keep only the newest MaxFreePerKey of this key
+	int32 SameKey = 0;
+	for (int32 Index = FreeRenderTargets.Num() - 1; Index >= 0; --Index)
+	{
+		const FPooledDataRenderTarget& Other = FreeRenderTargets[Index];
+		if (Other.Class == Pooled.Class && Other.Format == Pooled.Format && Other.RenderTarget &&
+			Other.RenderTarget->SizeX == RenderTarget->SizeX && Other.RenderTarget->SizeY == RenderTarget->SizeY &&
+			++SameKey > MaxFreePerKey)
+		{
+			FreeRenderTargets.RemoveAt(Index);
+			++Stats.Trimmed;
+		}
+	}
+}
+
+UMaterialInstanceDynamic* UDataRenderTargetPool::AcquireMaterial(UMaterialInterface* Parent)
+{
+	if (!Parent)
+	{
+		return nullptr;
+	}
+
+	for (int32 Index = FreeMaterials.Num() - 1; Index >= 0; --Index)
+	{
+		if (FreeMaterials[Index].Material && FreeMaterials[Index].Material->Parent == Parent)
+		{
+			UMaterialInstanceDynamic* Material = FreeMaterials[Index].Material;
+			FreeMaterials.RemoveAt(Index);
+			++Stats.Hits;
+			return Material;
+		}
+	}
+
+	++Stats.Misses;
+	return UMaterialInstanceDynamic::Create(Parent, this);
+}
+
+void UDataRenderTargetPool::ReleaseMaterial(UMaterialInstanceDynamic* Material)
+{
+	if (!Material)
+	{
+		return;
+	}
+
+	Material->ClearParameterValues();
+
+	FPooledDataMaterial& Pooled = FreeMaterials.AddDefaulted_GetRef();
+	Pooled.Material = Material;
+	Pooled.ReleaseTime = FPlatformTime::Seconds();
+
+	int32 SameKey = 0;
+	for (int32 Index = FreeMaterials.Num() - 1; Index >= 0; --Index)
+	{
+		const UMaterialInstanceDynamic* Other = FreeMaterials[Index].Material;
+		if (Other && Other->Parent == Material->Parent && ++SameKey > MaxFreePerKey)
+		{
+			FreeMaterials.RemoveAt(Index);
+			++Stats.Trimmed;
+		}
+	}
+}
+
+void UDataRenderTargetPool::Trim(float MaxIdle)
+{
+	const double Now = FPlatformTime::Seconds();
+	Stats.Trimmed += FreeRenderTargets.RemoveAll([Now, MaxIdle](const FPooledDataRenderTarget& Pooled)
+	{
+		return !Pooled.RenderTarget || Now - Pooled.ReleaseTime >= MaxIdle;
+	});
+	Stats.Trimmed += FreeMaterials.RemoveAll([Now, MaxIdle](const FPooledDataMaterial& Pooled)
+	{
+		return !Pooled.Material || Now - Pooled.ReleaseTime >= MaxIdle;
+	});
+}
+
+FDataRenderTargetPoolStats UDataRenderTargetPool::GetStats() const
+{
+	FDataRenderTargetPoolStats Result = Stats;
+	Result.FreeRenderTargets = FreeRenderTargets.Num();
+	Result.FreeMaterials = FreeMaterials.Num();
+	return Result;
+}
+
+void UDataRenderTargetPool::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	if (FreeRenderTargets.Num() > 0 || FreeMaterials.Num() > 0)
+	{
+		Trim(MaxIdleSeconds);
+	}
+}
+
+TStatId UDataRenderTargetPool::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDataRenderTargetPool, STATGROUP_Tickables);
+}
+
+void UDataRenderTargetPool::Deinitialize()
+{
+	FreeRenderTargets.Reset();
+	FreeMaterials.Reset();
+	Super::Deinitialize();
+}
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DataTextureUploader.h"
+#include "GpuDataManagerStats.h"
+
+UTexture2D* FDataTextureUploader::GetOrCreateTexture(UTexture2D* Texture, int32 SizeX, int32 SizeY, EPixelFormat Format)
+{
+	if (Texture && Texture->GetSizeX() == SizeX && Texture->GetSizeY() == SizeY && Texture->GetPixelFormat() == Format)
+	{
+		return Texture;
+	}
+
+	UTexture2D* NewTexture = UTexture2D::CreateTransient(SizeX, SizeY, Format);
+	if (!NewTexture)
+	{
+		return nullptr;
+	}
+
+	// Data textures are sampled texel by texel and hold linear values
+	NewTexture->Filter = TF_Nearest;
+	NewTexture->SRGB = false;
+	NewTexture->AddressX = TA_Clamp;
+	NewTexture->AddressY = TA_Clamp;
+	NewTexture->NeverStream = true;
+	NewTexture->UpdateResource();
+	return NewTexture;
+}
+
+void FDataTextureUploader::UploadRegions(UTexture2D* Texture, FDataTextureUpload& Upload, uint32 PixelBytes)
+{
+	if (!Texture || Upload.Regions.Num() == 0 || Upload.Pixels.Num() == 0)
+	{
+		return;
+	}
+
+	FGpuDataManagerStats::AddTextureBytesUploaded(Upload.Pixels.Num());
+
+	// Render thread reads the buffers of Upload in place, nothing to free once it is done
+	const uint32 SrcPitch = Texture->GetSizeX() * PixelBytes;
+	Texture->UpdateTextureRegions(0, Upload.Regions.Num(), Upload.Regions.GetData(), SrcPitch, PixelBytes,
+		Upload.Pixels.GetData());
+	Upload.Fence.BeginFence();
+}
+
+FUpdateTextureRegion2D FDataTextureUploader::MakeRowsRegion(int32 SizeX, int32 Num)
+{
+	const uint32 Rows = FMath::DivideAndRoundUp(Num, SizeX);
+	return FUpdateTextureRegion2D(0, 0, 0, 0, SizeX, Rows);
+}
+
+FDataTextureUploadRing::~FDataTextureUploadRing()
+{
+	for (FDataTextureUpload& Upload : Uploads)
+	{
+		Upload.Fence.Wait();
+	}
+}
+
+FDataTextureUpload& FDataTextureUploadRing::Acquire()
+{
+	FDataTextureUpload& Upload = Uploads[Next];
+	Next = (Next + 1) % RingSize;
+
+	// Usually completed frames ago
+	Upload.Fence.Wait();
+	Upload.Regions.Reset();
+	Upload.Pixels.Reset();
+	return Upload;
+}
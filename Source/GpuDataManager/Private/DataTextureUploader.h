@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/Texture2D.h"
+#include "RenderCommandFence.h"
+#include "GenericDataArray.h"
+
+// Staging memory of one upload, kept between updates so packing reuses the allocations once they have grown
+struct FDataTextureUpload
+{
+	TArray<FUpdateTextureRegion2D> Regions;
+	TArray<uint8> Pixels;
+	// Scratch for PackDirtyRegions
+	TArray<FIntRect> DirtyRects;
+	// Render thread is done with Regions and Pixels once this completes
+	FRenderCommandFence Fence;
+};
+
+// Ring of uploads, the render thread reads an upload until its command completes while the next ones are packed
+class FDataTextureUploadRing
+{
+public:
+	~FDataTextureUploadRing();
+
+	// Next upload emptied with its allocations kept, waits when the render thread still reads it
+	FDataTextureUpload& Acquire();
+	TConstArrayView<FDataTextureUpload> GetUploads() const { return Uploads; }
+
+	static constexpr int32 RingSize = 3;
+
+private:
+	FDataTextureUpload Uploads[RingSize];
+	int32 Next = 0;
+};
+
+// Upload of plain arrays into transient textures by region copies instead of per-pixel canvas items
+class FDataTextureUploader
+{
+public:
+	// Returns Texture if it already matches size and format, otherwise a new transient texture
+	static UTexture2D* GetOrCreateTexture(UTexture2D* Texture, int32 SizeX, int32 SizeY, EPixelFormat Format);
+
+	// Copies Upload.Pixels (texture-wide rows of PixelBytes each) into Upload.Regions of Texture on the render thread,
+	// Upload must not be packed again before Upload.Fence completes
+	static void UploadRegions(UTexture2D* Texture, FDataTextureUpload& Upload, uint32 PixelBytes);
+
+	// Appends dirty regions of Array (rows of Array.GetRowWidth()) to Upload.Pixels as rows of TexturePitch pixels (SrcX = 0)
+	// and regions placed at DestOffset of the texture, converting each row with ConvertRow(Source, Count, Destination);
+	// elements past the end of Array are uploaded as zeroes
+	template <typename T, typename FConvertRow>
+	static void PackDirtyRegions(const TGenericDataArray<T>& Array, int32 TexturePitch, uint32 PixelBytes,
+		FIntPoint DestOffset, FConvertRow ConvertRow, FDataTextureUpload& Upload);
+
+	// Single region covering the first Num pixels of SizeX-wide rows
+	static FUpdateTextureRegion2D MakeRowsRegion(int32 SizeX, int32 Num);
+};
+
+template <typename T, typename FConvertRow>
+void FDataTextureUploader::PackDirtyRegions(const TGenericDataArray<T>& Array, int32 TexturePitch, uint32 PixelBytes,
+	FIntPoint DestOffset, FConvertRow ConvertRow, FDataTextureUpload& Upload)
+{
+	const int32 RowBytes = TexturePitch * PixelBytes;
+	Array.GetDirtyRegions(Upload.DirtyRects);
+	int32 PackedRows = 0;
+	for (const FIntRect& Rect : Upload.DirtyRects)
+	{
+		PackedRows += Rect.Height();
+	}
+
+	TArray<uint8>& OutPixels = Upload.Pixels;
+	int32 PackedRow = OutPixels.Num() / RowBytes;
+	OutPixels.SetNumZeroed(OutPixels.Num() + PackedRows * RowBytes, EAllowShrinking::No);
+
+	const int32 Num = Array.GetArraySize();
+	const int32 ArrayRowWidth = Array.GetRowWidth();
+	for (const FIntRect& Rect : Upload.DirtyRects)
+	{
+		Upload.Regions.Emplace(DestOffset.X + Rect.Min.X, DestOffset.Y + Rect.Min.Y, 0, PackedRow, Rect.Width(), Rect.Height());
+		for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; ++Y, ++PackedRow)
+		{
+			const int32 Begin = Y * ArrayRowWidth + Rect.Min.X;
+			const int32 Count = FMath::Clamp(Num - Begin, 0, Rect.Width());
+			if (Count > 0)
+			{
+				ConvertRow(Array.GetData() + Begin, Count, OutPixels.GetData() + PackedRow * RowBytes);
+			}
+		}
+	}
+}
@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "UObject/Object.h"
+#include "Async/ParallelFor.h"
+#include "DataArrayKernels.h"
 #include <type_traits>
 #include "GenericDataArray.generated.h"
 
@@ -11,16 +13,56 @@ template <typename T>
 class TGenericDataArray
 {
 public:
-	explicit TGenericDataArray(int32 Capacity, bool ShouldPreAllocateArray = true);
+	// RowWidth is the texture width used to map elements to dirty tiles, square texture is assumed when 0
+	explicit TGenericDataArray(int32 Capacity, bool ShouldPreAllocateArray = true, int32 RowWidth = 0);
 	
 	bool SetPlainArrayElement(int32 Index, T Value);
-	bool SetArray(TArray<T> Array);
-	int32 GetArraySize();
+	// Copies into the preallocated storage, no allocation while Array fits into Capacity
+	bool SetArray(const TArray<T>& Array);
+	bool SetArray(TConstArrayView<T> Array);
+	// Takes Array storage over without copy when it can hold Capacity elements, otherwise copies like the view overload
+	// so the preallocated storage is kept; allocation-free only in the copying case, the caller allocated Array
+	bool SetArray(TArray<T>&& Array);
+	// Resizes to Num within the preallocated storage and returns it for in-place writes, empty view if Num exceeds Capacity
+	TArrayView<T> GetWritableView(int32 Num);
+	int32 GetArraySize() const;
+	const T* GetData() const { return Data.GetData(); }
+	SIZE_T GetAllocatedSize() const { return Data.GetAllocatedSize(); }
 	int32 GetArrayCapacity() const;
 	bool ResizeArray(int32 NewSize);
 
 	bool ValidatePlaneIndex(int32 Index);
 
+	// Dirty tracking, elements written through SetPlainArrayElement/SetArray are marked automatically
+	static constexpr int32 DirtyTileSize = 16;
+	void MarkDirty(int32 Index);
+	void MarkAllDirty();
+	void ClearDirty();
+	bool IsDirty() const;
+	// Rectangles (Max exclusive) covering dirty tiles in texture coordinates, horizontally adjacent tiles are merged;
+	// OutRegions is reset, its allocation is kept
+	void GetDirtyRegions(TArray<FIntRect>& OutRegions) const;
+	int32 GetRowWidth() const { return RowWidth; }
+	void MarkDirtyRect(const FIntRect& Rect);
+
+	// Bulk operations over the first GetArraySize() elements; arrays longer than ParallelChunkSize are processed
+	// in ParallelFor chunks, so Map functions must be safe to call from several threads
+	static constexpr int32 ParallelChunkSize = 32 * 1024;
+	void Fill(const T& Value);
+	// Element = Function(Element)
+	template <typename FMapFunction>
+	void Map(FMapFunction Function);
+	// Function(Index, Element) on the calling thread, in order
+	template <typename FVisitFunction>
+	void ForEachElement(FVisitFunction Function) const;
+	// Float and FVector3f only, vectors component-wise; false for empty array
+	bool ReduceMinMax(T& OutMin, T& OutMax) const;
+	// Maps [Min, Max] onto [0, 1], float and FVector3f only
+	void Normalize(const T& Min, const T& Max);
+	bool Normalize();
+	// Copies SourceRect (texture coordinates of Source) to DestOffset, both clipped to the arrays
+	bool CopyRegion(const TGenericDataArray& Source, FIntRect SourceRect, FIntPoint DestOffset);
+
 	template <typename U>// requires std::is_same_v<T, U>
 	requires requires { typename std::enable_if_t<std::is_same_v<T, U>>; }
 	class TGenericDataArrayIterator
@@ -41,14 +83,27 @@ public:
 	TGenericDataArrayIterator<T> Begin();
 
 protected:
+	// Calls Function(Begin, Count) for every chunk of Num elements
+	template <typename FChunkFunction>
+	static void ForEachChunk(int32 Num, FChunkFunction Function);
+
 	TArray<T> Data;
 	int32 Capacity {};
+
+	int32 RowWidth {};
+	int32 TilesX {};
+	int32 TilesY {};
+	TBitArray<> DirtyTiles;
 };
 
 template <typename T>
-TGenericDataArray<T>::TGenericDataArray(int32 Capacity, bool ShouldPreAllocateArray)
+TGenericDataArray<T>::TGenericDataArray(int32 Capacity, bool ShouldPreAllocateArray, int32 RowWidth)
 {
 	this->Capacity = Capacity;
+	this->RowWidth = FMath::Max(1, RowWidth > 0 ? RowWidth : FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(Capacity))));
+	TilesX = FMath::DivideAndRoundUp(this->RowWidth, DirtyTileSize);
+	TilesY = FMath::DivideAndRoundUp(FMath::DivideAndRoundUp(Capacity, this->RowWidth), DirtyTileSize);
+	DirtyTiles.Init(true, TilesX * TilesY);
 
 	if (ShouldPreAllocateArray)
 	{
@@ -63,12 +118,19 @@ bool TGenericDataArray<T>::SetPlainArrayElement(int32 Index, T Value)
 	if (IsIndexValid)
 	{
 		Data[Index] = Value;
+		MarkDirty(Index);
 	}
 	return IsIndexValid;
 }
 
 template <typename T>
-bool TGenericDataArray<T>::SetArray(TArray<T> Array)
+bool TGenericDataArray<T>::SetArray(const TArray<T>& Array)
+{
+	return SetArray(TConstArrayView<T>(Array));
+}
+
+template <typename T>
+bool TGenericDataArray<T>::SetArray(TConstArrayView<T> Array)
 {
 	// Capacity tells us the size RenderTarget, to use bigger array reinit this
 	if (Array.Num() > Capacity)
@@ -76,12 +138,47 @@ bool TGenericDataArray<T>::SetArray(TArray<T> Array)
 		return false;
 	}
 
-	Data = Array;
+	// Reset keeps the allocation
+	Data.Reset();
+	Data.Append(Array.GetData(), Array.Num());
+	MarkAllDirty();
 	return true;
 }
 
 template <typename T>
-int32 TGenericDataArray<T>::GetArraySize()
+bool TGenericDataArray<T>::SetArray(TArray<T>&& Array)
+{
+	if (Array.Num() > Capacity)
+	{
+		return false;
+	}
+
+	// Smaller storage would reallocate on the next update up to Capacity
+	if (Array.Max() < Capacity)
+	{
+		return SetArray(TConstArrayView<T>(Array));
+	}
+
+	Data = MoveTemp(Array);
+	MarkAllDirty();
+	return true;
+}
+
+template <typename T>
+TArrayView<T> TGenericDataArray<T>::GetWritableView(int32 Num)
+{
+	if (Num < 0 || Num > Capacity)
+	{
+		return {};
+	}
+
+	Data.SetNumUninitialized(Num, EAllowShrinking::No);
+	MarkAllDirty();
+	return TArrayView<T>(Data);
+}
+
+template <typename T>
+int32 TGenericDataArray<T>::GetArraySize() const
 {
 	return Data.Num();
 }
@@ -101,6 +198,7 @@ bool TGenericDataArray<T>::ResizeArray(int32 NewSize)
 	}
 
 	Data.ResizeTo(NewSize);
+	MarkAllDirty();
 	return true;
 }
 
@@ -110,6 +208,230 @@ bool TGenericDataArray<T>::ValidatePlaneIndex(int32 Index)
 	return Index >= 0 && Index < Data.Num();
 }
 
+template <typename T>
+void TGenericDataArray<T>::MarkDirty(int32 Index)
+{
+	const int32 TileX = Index % RowWidth / DirtyTileSize;
+	const int32 TileY = Index / RowWidth / DirtyTileSize;
+	if (TileY < TilesY)
+	{
+		DirtyTiles[TileX + TileY * TilesX] = true;
+	}
+}
+
+template <typename T>
+void TGenericDataArray<T>::MarkAllDirty()
+{
+	DirtyTiles.SetRange(0, DirtyTiles.Num(), true);
+}
+
+template <typename T>
+void TGenericDataArray<T>::ClearDirty()
+{
+	DirtyTiles.SetRange(0, DirtyTiles.Num(), false);
+}
+
+template <typename T>
+bool TGenericDataArray<T>::IsDirty() const
+{
+	return DirtyTiles.Contains(true);
+}
+
+template <typename T>
+void TGenericDataArray<T>::MarkDirtyRect(const FIntRect& Rect)
+{
+	if (Rect.Width() <= 0 || Rect.Height() <= 0)
+	{
+		return;
+	}
+
+	const int32 MinTileX = FMath::Max(Rect.Min.X / DirtyTileSize, 0);
+	const int32 MaxTileX = FMath::Min((Rect.Max.X - 1) / DirtyTileSize, TilesX - 1);
+	const int32 MinTileY = FMath::Max(Rect.Min.Y / DirtyTileSize, 0);
+	const int32 MaxTileY = FMath::Min((Rect.Max.Y - 1) / DirtyTileSize, TilesY - 1);
+	for (int32 TileY = MinTileY; TileY <= MaxTileY; ++TileY)
+	{
+		if (MaxTileX >= MinTileX)
+		{
+			DirtyTiles.SetRange(MinTileX + TileY * TilesX, MaxTileX - MinTileX + 1, true);
+		}
+	}
+}
+
+template <typename T>
+template <typename FChunkFunction>
+void TGenericDataArray<T>::ForEachChunk(int32 Num, FChunkFunction Function)
+{
+	const int32 Chunks = FMath::DivideAndRoundUp(Num, ParallelChunkSize);
+	ParallelFor(Chunks, [&](int32 Chunk)
+	{
+		const int32 Begin = Chunk * ParallelChunkSize;
+		Function(Begin, FMath::Min(ParallelChunkSize, Num - Begin));
+	}, Chunks > 1 ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+}
+
+template <typename T>
+void TGenericDataArray<T>::Fill(const T& Value)
+{
+	T* Elements = Data.GetData();
+	ForEachChunk(Data.Num(), [Elements, &Value](int32 Begin, int32 Count)
+	{
+		for (int32 Index = Begin; Index < Begin + Count; ++Index)
+		{
+			Elements[Index] = Value;
+		}
+	});
+	MarkAllDirty();
+}
+
+template <typename T>
+template <typename FMapFunction>
+void TGenericDataArray<T>::Map(FMapFunction Function)
+{
+	T* Elements = Data.GetData();
+	ForEachChunk(Data.Num(), [Elements, &Function](int32 Begin, int32 Count)
+	{
+		for (int32 Index = Begin; Index < Begin + Count; ++Index)
+		{
+			Elements[Index] = Function(Elements[Index]);
+		}
+	});
+	MarkAllDirty();
+}
+
+template <typename T>
+template <typename FVisitFunction>
+void TGenericDataArray<T>::ForEachElement(FVisitFunction Function) const
+{
+	for (int32 Index = 0; Index < Data.Num(); ++Index)
+	{
+		Function(Index, Data[Index]);
+	}
+}
+
+template <typename T>
+bool TGenericDataArray<T>::ReduceMinMax(T& OutMin, T& OutMax) const
+{
+	if (Data.Num() == 0)
+	{
+		return false;
+	}
+
+	// Every chunk reduces on its own, chunk results are reduced afterwards
+	const int32 Chunks = FMath::DivideAndRoundUp(Data.Num(), ParallelChunkSize);
+	TArray<T, TInlineAllocator<64>> ChunkMin, ChunkMax;
+	ChunkMin.SetNumUninitialized(Chunks);
+	ChunkMax.SetNumUninitialized(Chunks);
+	const T* Elements = Data.GetData();
+	ForEachChunk(Data.Num(), [Elements, &ChunkMin, &ChunkMax](int32 Begin, int32 Count)
+	{
+		const int32 Chunk = Begin / ParallelChunkSize;
+		ChunkMin[Chunk] = ChunkMax[Chunk] = Elements[Begin];
+		FDataArrayKernels::ReduceMinMax(Elements + Begin, Count, ChunkMin[Chunk], ChunkMax[Chunk]);
+	});
+
+	T Unused = ChunkMin[0];
+	OutMin = ChunkMin[0];
+	FDataArrayKernels::ReduceMinMax(ChunkMin.GetData(), Chunks, OutMin, Unused);
+	OutMax = ChunkMax[0];
+	Unused = ChunkMax[0];
+	FDataArrayKernels::ReduceMinMax(ChunkMax.GetData(), Chunks, Unused, OutMax);
+	return true;
+}
+
+template <typename T>
+void TGenericDataArray<T>::Normalize(const T& Min, const T& Max)
+{
+	const T Scale = FDataArrayKernels::GetNormalizeScale(Max - Min);
+	const T Bias = -Min * Scale;
+	T* Elements = Data.GetData();
+	ForEachChunk(Data.Num(), [Elements, &Scale, &Bias](int32 Begin, int32 Count)
+	{
+		FDataArrayKernels::ScaleBias(Elements + Begin, Count, Scale, Bias);
+	});
+	MarkAllDirty();
+}
+
+template <typename T>
+bool TGenericDataArray<T>::Normalize()
+{
+	T Min, Max;
+	if (!ReduceMinMax(Min, Max))
+	{
+		return false;
+	}
+	Normalize(Min, Max);
+	return true;
+}
+
+template <typename T>
+bool TGenericDataArray<T>::CopyRegion(const TGenericDataArray& Source, FIntRect SourceRect, FIntPoint DestOffset)
+{
+	// Clip source rect to the source and the destination
+	SourceRect.Clip(FIntRect(0, 0, Source.RowWidth, FMath::DivideAndRoundUp(Source.Capacity, Source.RowWidth)));
+	const FIntPoint DestMax = FIntPoint(RowWidth, FMath::DivideAndRoundUp(Capacity, RowWidth));
+	const FIntPoint Size(
+		FMath::Min(SourceRect.Width(), DestMax.X - DestOffset.X),
+		FMath::Min(SourceRect.Height(), DestMax.Y - DestOffset.Y));
+	if (DestOffset.X < 0 || DestOffset.Y < 0 || Size.X <= 0 || Size.Y <= 0)
+	{
+		return false;
+	}
+
+	const int32 RequiredNum = FMath::Min((DestOffset.Y + Size.Y - 1) * RowWidth + DestOffset.X + Size.X, Capacity);
+	if (Data.Num() < RequiredNum)
+	{
+		Data.SetNumZeroed(RequiredNum, EAllowShrinking::No);
+	}
+
+	// Rows are walked backwards when copying down inside the same array, so source rows aren't overwritten first
+	const bool Backwards = &Source == this && DestOffset.Y > SourceRect.Min.Y;
+	for (int32 Step = 0; Step < Size.Y; ++Step)
+	{
+		const int32 Row = Backwards ? Size.Y - 1 - Step : Step;
+		const int32 SourceBegin = (SourceRect.Min.Y + Row) * Source.RowWidth + SourceRect.Min.X;
+		const int32 DestBegin = (DestOffset.Y + Row) * RowWidth + DestOffset.X;
+		// Last row of a Capacity that is not a multiple of RowWidth is partial
+		const int32 DestCount = FMath::Clamp(Capacity - DestBegin, 0, Size.X);
+		const int32 Count = FMath::Clamp(Source.Data.Num() - SourceBegin, 0, DestCount);
+		FMemory::Memmove(Data.GetData() + DestBegin, Source.Data.GetData() + SourceBegin, Count * sizeof(T));
+		FMemory::Memzero(Data.GetData() + DestBegin + Count, (DestCount - Count) * sizeof(T));
+	}
+	MarkDirtyRect(FIntRect(DestOffset, DestOffset + Size));
+	return true;
+}
+
+template <typename T>
+void TGenericDataArray<T>::GetDirtyRegions(TArray<FIntRect>& OutRegions) const
+{
+	const int32 Rows = FMath::DivideAndRoundUp(Capacity, RowWidth);
+
+	OutRegions.Reset();
+	for (int32 TileY = 0; TileY < TilesY; ++TileY)
+	{
+		int32 TileX = 0;
+		while (TileX < TilesX)
+		{
+			if (!DirtyTiles[TileX + TileY * TilesX])
+			{
+				++TileX;
+				continue;
+			}
+
+			const int32 RunBegin = TileX;
+			while (TileX < TilesX && DirtyTiles[TileX + TileY * TilesX])
+			{
+				++TileX;
+			}
+			OutRegions.Emplace(
+				RunBegin * DirtyTileSize,
+				TileY * DirtyTileSize,
+				FMath::Min(TileX * DirtyTileSize, RowWidth),
+				FMath::Min((TileY + 1) * DirtyTileSize, Rows));
+		}
+	}
+}
+
 template <typename T>
 template <typename U>//requires std::is_same_v<T, U>
 requires requires { typename std::enable_if_t<std::is_same_v<T, U>>; }
@@ -158,6 +480,12 @@ UENUM()
 enum class EArrayTypes
 {
 	Float,
-	FVector3f
+	FVector3f,
+	// Float array quantized to unorm8 ([0, 1] range)
+	FloatR8,
+	// Float array as half floats
+	FloatR16F,
+	// Up to four float channel arrays quantized to unorm8 and packed into RGBA of one texel
+	PackedRGBA8
 };
 
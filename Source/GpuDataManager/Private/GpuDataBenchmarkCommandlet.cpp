@@ -0,0 +1,755 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GpuDataBenchmarkCommandlet.h"
+#include "ActorSlicer.h"
+#include "CloudCache.h"
+#include "DataArrayKernels.h"
+#include "DataTextureUploader.h"
+#include "GenericDataArray.h"
+#include "Components/StaticMeshComponent.h"
+#include "Dom/JsonObject.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+#define LOG_ERROR(ErrorText) UE_LOG(LogTemp, Warning, TEXT("GpuDataBenchmark %s: %s"), *FString(__func__), *FString(ErrorText));
+
+namespace
+{
+	struct FBenchmarkResult
+	{
+		FString Group;
+		FString Name;
+		// Best of the runs
+		double Seconds = 0;
+		double Items = 0;
+		// traces, pixels, MB, elements
+		FString Unit;
+		// Simulated L1 misses per item, negative when not measured
+		double MissesPerItem = -1;
+		// Plain over compressed allocated size, negative when not measured
+		double CompressionRatio = -1;
+
+		double GetThroughput() const { return Seconds > 0 ? Items / Seconds : 0; }
+		FString GetKey() const { return Group + TEXT("/") + Name; }
+	};
+
+	// Runs Function Runs times and keeps the fastest run
+	template <typename FFunction>
+	double TimeBest(int32 Runs, FFunction Function)
+	{
+		double Best = TNumericLimits<double>::Max();
+		for (int32 Run = 0; Run < Runs; ++Run)
+		{
+			const double Begin = FPlatformTime::Seconds();
+			Function();
+			Best = FMath::Min(Best, FPlatformTime::Seconds() - Begin);
+		}
+		return Best;
+	}
+
+	UWorld* CreateBenchmarkWorld()
+	{
+		// Slicer traces need collision, nothing else
+		UWorld::InitializationValues Values = UWorld::InitializationValues()
+			.InitializeScenes(false)
+			.AllowAudioPlayback(false)
+			.RequiresHitProxies(false)
+			.CreatePhysicsScene(true)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.ShouldSimulatePhysics(false)
+			.EnableTraceCollision(true)
+			.SetTransactional(false)
+			.CreateFXSystem(false);
+		return UWorld::CreateWorld(EWorldType::Editor, false, TEXT("GpuDataBenchmark"), nullptr, true,
+			ERHIFeatureLevel::Num, &Values);
+	}
+
+	AActor* SpawnShape(UWorld* World, UStaticMesh* Mesh, const FTransform& Transform)
+	{
+		AStaticMeshActor* Actor = World->SpawnActor<AStaticMeshActor>(AStaticMeshActor::StaticClass(), Transform);
+		if (!Actor)
+		{
+			return nullptr;
+		}
+		UStaticMeshComponent* Component = Actor->GetStaticMeshComponent();
+		Component->SetMobility(EComponentMobility::Movable);
+		Component->SetStaticMesh(Mesh);
+		// Slicer traces WorldDynamic objects only
+		Component->SetCollisionObjectType(ECC_WorldDynamic);
+		Component->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+		Component->RecreatePhysicsState();
+		return Actor;
+	}
+
+	// Scene content inside a box of half size 500 around the origin
+	TArray<AActor*> BuildScene(UWorld* World, const FString& Scene)
+	{
+		UStaticMesh* Sphere = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Sphere.Sphere"));
+		UStaticMesh* Cube = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+		TArray<AActor*> Actors;
+		if (!Sphere || !Cube)
+		{
+			return Actors;
+		}
+
+		if (Scene == TEXT("Spheres"))
+		{
+			for (int32 Index = 0; Index < 8; ++Index)
+			{
+				const FVector Location((Index & 1) ? 250 : -250, (Index & 2) ? 250 : -250, (Index & 4) ? 250 : -250);
+				Actors.Add(SpawnShape(World, Sphere, FTransform(FQuat::Identity, Location, FVector(3))));
+			}
+		}
+		else if (Scene == TEXT("ThinShells"))
+		{
+			for (int32 Index = 0; Index < 6; ++Index)
+			{
+				const FRotator Rotation(Index * 15.0, Index * 30.0, 0);
+				const FVector Location(0, 0, -400 + Index * 160);
+				Actors.Add(SpawnShape(World, Cube, FTransform(Rotation, Location, FVector(8, 8, 0.02))));
+			}
+		}
+		else if (Scene == TEXT("SmallBoxes"))
+		{
+			for (int32 X = 0; X < 10; ++X)
+			{
+				for (int32 Y = 0; Y < 10; ++Y)
+				{
+					for (int32 Z = 0; Z < 10; ++Z)
+					{
+						const FVector Location(-450 + X * 100, -450 + Y * 100, -450 + Z * 100);
+						Actors.Add(SpawnShape(World, Cube, FTransform(FQuat::Identity, Location, FVector(0.2))));
+					}
+				}
+			}
+		}
+		Actors.Remove(nullptr);
+		return Actors;
+	}
+
+	void BenchmarkSlicer(UWorld* World, bool Quick, TArray<FBenchmarkResult>& Results)
+	{
+		const FVector BoxLocation = FVector::ZeroVector;
+		const FVector BoxExtent(500);
+		// Compression ratio is measured at every density, rows of 128 points are the size clouds are usually baked at
+		const TArray<int32> Densities = Quick ? TArray<int32> { 32, 128 } : TArray<int32> { 32, 64, 128 };
+		const TArray<int32> Resolutions = Quick ? TArray<int32> { 128 } : TArray<int32> { 64, 128, 256, 512 };
+
+		UCloudCache* Cache = NewObject<UCloudCache>();
+		Cache->AddToRoot();
+		AActor* Owner = World->SpawnActor<AActor>();
+		UActorSlicer* Slicer = NewObject<UActorSlicer>(Owner);
+		Slicer->RegisterComponent();
+		Slicer->SetCachePointer(Cache, TEXT("Benchmark"));
+
+		for (const FString Scene : { TEXT("Spheres"), TEXT("ThinShells"), TEXT("SmallBoxes") })
+		{
+			TArray<AActor*> Actors = BuildScene(World, Scene);
+			if (Actors.Num() == 0)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("GpuDataBenchmark: can't build scene %s"), *Scene);
+				continue;
+			}
+
+			for (const int32 Density : Densities)
+			{
+				const FIntVector PointDensity(Density);
+				FBenchmarkResult& Result = Results.AddDefaulted_GetRef();
+				Result.Group = TEXT("GeneratePointCloud");
+				Result.Name = FString::Printf(TEXT("%s_%d"), *Scene, Density);
+				// Two traces per point
+				Result.Items = 2.0 * Density * Density * Density;
+				Result.Unit = TEXT("traces");
+				Result.Seconds = TimeBest(Quick ? 1 : 3, [&]
+				{
+					Slicer->GeneratePointCloud(BoxLocation, BoxExtent, PointDensity);
+				});
+
+				const FPointCloud* Cloud = Cache->FindCloud(TEXT("Benchmark"));
+				if (!Cloud)
+				{
+					continue;
+				}
+				FRlePointCloud Compressed;
+				FBenchmarkResult& Encode = Results.AddDefaulted_GetRef();
+				Encode.Group = TEXT("CompressPointCloud");
+				Encode.Name = Result.Name;
+				Encode.Items = static_cast<double>(Density) * Density * Density;
+				Encode.Unit = TEXT("points");
+				Encode.Seconds = TimeBest(Quick ? 1 : 3, [&]
+				{
+					Compressed = FRlePointCloud::Encode(*Cloud);
+				});
+				Encode.CompressionRatio = static_cast<double>(Cloud->GetAllocatedSize()) / FMath::Max<SIZE_T>(Compressed.GetAllocatedSize(), 1);
+			}
+
+			for (const int32 Resolution : Resolutions)
+			{
+				FBenchmarkResult& Result = Results.AddDefaulted_GetRef();
+				Result.Group = TEXT("CalculateSliceOnPlane");
+				Result.Name = FString::Printf(TEXT("%s_%d"), *Scene, Resolution);
+				Result.Items = static_cast<double>(Resolution) * Resolution;
+				Result.Unit = TEXT("pixels");
+				Result.Seconds = TimeBest(Quick ? 1 : 5, [&]
+				{
+					Slicer->CalculateSliceOnPlane(BoxLocation, FRotator(30, 20, 0), BoxExtent, FRotator::ZeroRotator,
+						BoxLocation, FVector2D(1000), FIntPoint(Resolution));
+				});
+			}
+
+			for (AActor* Actor : Actors)
+			{
+				Actor->Destroy();
+			}
+		}
+
+		Owner->Destroy();
+		Cache->RemoveFromRoot();
+	}
+
+	// 32 KB 8-way LRU cache of 64 byte lines, the usual L1D
+	class FSimulatedCache
+	{
+	public:
+		FSimulatedCache()
+		{
+			Lines.Init(MAX_uint64, Sets * Ways);
+		}
+
+		void Touch(uint64 Address)
+		{
+			const uint64 Line = Address >> 6;
+			uint64* Set = &Lines[(Line % Sets) * Ways];
+			int32 Way = 0;
+			while (Way < Ways - 1 && Set[Way] != Line)
+			{
+				++Way;
+			}
+			Misses += Set[Way] != Line;
+			// Most recent line first
+			FMemory::Memmove(Set + 1, Set, Way * sizeof(uint64));
+			Set[0] = Line;
+		}
+
+		int64 Misses = 0;
+
+	private:
+		static constexpr int32 Sets = 64;
+		static constexpr int32 Ways = 8;
+		TArray<uint64> Lines;
+	};
+
+	// Replays lookups of CalculateSliceOnPlane for a plane through the cloud center, bool points are one byte each
+	double SimulateSliceMisses(const FPointCloud& Cloud, const FRotator& PlaneRotation, int32 Resolution)
+	{
+		const FRotationMatrix PlaneRotator(PlaneRotation);
+		const FVector XAxis = PlaneRotator.GetUnitAxis(EAxis::X);
+		const FVector YAxis = PlaneRotator.GetUnitAxis(EAxis::Y);
+		const FVector Center = FVector(Cloud.PointDensity) / 2;
+		const double Size = Cloud.PointDensity.GetMax();
+
+		FSimulatedCache Cache;
+		for (int32 Y = 0; Y < Resolution; ++Y)
+		{
+			for (int32 X = 0; X < Resolution; ++X)
+			{
+				const FVector Point = Center + XAxis * Size * (static_cast<double>(X) / (Resolution - 1) - 0.5) +
+					YAxis * Size * (static_cast<double>(Y) / (Resolution - 1) - 0.5);
+				const FIntVector Coords(
+					FMath::Clamp(FMath::FloorToInt32(Point.X), 0, Cloud.PointDensity.X - 1),
+					FMath::Clamp(FMath::FloorToInt32(Point.Y), 0, Cloud.PointDensity.Y - 1),
+					FMath::Clamp(FMath::FloorToInt32(Point.Z), 0, Cloud.PointDensity.Z - 1));
+				for (int32 Neighbour = 0; Neighbour < 8; ++Neighbour)
+				{
+					const FIntVector NeighbourCoords = Coords + FIntVector(Neighbour & 1, (Neighbour >> 1) & 1, Neighbour >> 2);
+					if (Cloud.IsValid(NeighbourCoords))
+					{
+						Cache.Touch(Cloud.ToIndex(NeighbourCoords));
+					}
+				}
+			}
+		}
+		return static_cast<double>(Cache.Misses) / (static_cast<double>(Resolution) * Resolution);
+	}
+
+	void BenchmarkCloudLayouts(bool Quick, TArray<FBenchmarkResult>& Results)
+	{
+		const int32 Density = Quick ? 128 : 256;
+		const int32 Resolution = Quick ? 256 : 512;
+
+		// Filled sphere with noise, slicing cost does not depend on the scene
+		FRandomStream Random(2468);
+		FPointCloud LinearCloud;
+		LinearCloud.PointDensity = FIntVector(Density);
+		const FVector Center(Density / 2.0);
+		for (int32 Z = 0; Z < Density; ++Z)
+		{
+			for (int32 Y = 0; Y < Density; ++Y)
+			{
+				for (int32 X = 0; X < Density; ++X)
+				{
+					LinearCloud.Add(FVector::Dist(FVector(X, Y, Z), Center) < Density * 0.4 || Random.FRand() < 0.05f);
+				}
+			}
+		}
+		const FPointCloud BrickCloud = LinearCloud.ToLayout(EPointCloudLayout::Bricks);
+
+		UCloudCache* Cache = NewObject<UCloudCache>();
+		Cache->AddToRoot();
+		Cache->SetCloudValue(TEXT("Linear"), LinearCloud);
+		Cache->SetCloudValue(TEXT("Bricks"), BrickCloud);
+		UActorSlicer* Slicer = NewObject<UActorSlicer>();
+
+		// Physical size equals density, one slice pixel per cloud point along an axis
+		const FVector Extent(Density / 2.0);
+		const TPair<const TCHAR*, FRotator> Planes[] = {
+			{ TEXT("XY"), FRotator::ZeroRotator },
+			{ TEXT("XZ"), FRotator(0, 0, 90) },
+			{ TEXT("YZ"), FRotator(90, 0, 0) },
+			{ TEXT("Oblique"), FRotator(30, 20, 0) },
+			{ TEXT("Steep"), FRotator(60, 45, 30) } };
+		for (const auto& [PlaneName, PlaneRotation] : Planes)
+		{
+			for (const FPointCloud* Cloud : { &LinearCloud, &BrickCloud })
+			{
+				const TCHAR* LayoutName = Cloud == &LinearCloud ? TEXT("Linear") : TEXT("Bricks");
+				Slicer->SetCachePointer(Cache, LayoutName);
+
+				FBenchmarkResult& Result = Results.AddDefaulted_GetRef();
+				Result.Group = TEXT("CloudLayout");
+				Result.Name = FString::Printf(TEXT("%s_%s_%d"), LayoutName, PlaneName, Density);
+				Result.Items = static_cast<double>(Resolution) * Resolution;
+				Result.Unit = TEXT("pixels");
+				Result.Seconds = TimeBest(Quick ? 1 : 5, [&]
+				{
+					Slicer->CalculateSliceOnPlane(FVector::ZeroVector, PlaneRotation, Extent, FRotator::ZeroRotator,
+						FVector::ZeroVector, FVector2D(Density), FIntPoint(Resolution));
+				});
+				Result.MissesPerItem = SimulateSliceMisses(*Cloud, PlaneRotation, Resolution);
+			}
+		}
+
+		Cache->RemoveFromRoot();
+	}
+
+	void BenchmarkCacheIO(const FString& WorkDirectory, bool Quick, TArray<FBenchmarkResult>& Results)
+	{
+		const TArray<int32> SliceCounts = Quick ? TArray<int32> { 16 } : TArray<int32> { 16, 64, 256 };
+		constexpr int32 SliceSize = 256;
+		FRandomStream Random(1234);
+
+		for (const int32 SliceCount : SliceCounts)
+		{
+			UCloudCache* Cache = NewObject<UCloudCache>();
+			Cache->AddToRoot();
+
+			FPointCloud Cloud;
+			Cloud.PointDensity = FIntVector(64);
+			for (int64 Index = 0; Index < Cloud.GetTotalPoints(); ++Index)
+			{
+				Cloud.Add(Random.FRand() < 0.3f);
+			}
+			Cache->SetCloudValue(TEXT("Benchmark"), MoveTemp(Cloud));
+
+			int64 PayloadBytes = 64 * 64 * 64;
+			for (int32 Index = 0; Index < SliceCount; ++Index)
+			{
+				TArray<float> Data;
+				Data.SetNumUninitialized(SliceSize * SliceSize);
+				for (float& Value : Data)
+				{
+					Value = Random.FRand();
+				}
+				PayloadBytes += Data.Num() * sizeof(float);
+				Cache->SetSlice(TEXT("Benchmark"), *FString::Printf(TEXT("Slice%d"), Index),
+					FSlice(MoveTemp(Data), FVector2D(1000), FIntPoint(SliceSize)));
+			}
+			const double Megabytes = PayloadBytes / (1024.0 * 1024.0);
+			const int32 Runs = Quick ? 1 : 3;
+
+			const FString BinaryFile = WorkDirectory / FString::Printf(TEXT("Pack%d.cloudcache"), SliceCount);
+			FBenchmarkResult& SaveBinary = Results.AddDefaulted_GetRef();
+			SaveBinary = { TEXT("CacheIO"), FString::Printf(TEXT("SaveBinary_%d"), SliceCount), 0, Megabytes, TEXT("MB") };
+			SaveBinary.Seconds = TimeBest(Runs, [&] { Cache->SaveBinary(BinaryFile); });
+
+			FBenchmarkResult& LoadBinary = Results.AddDefaulted_GetRef();
+			LoadBinary = { TEXT("CacheIO"), FString::Printf(TEXT("LoadBinary_%d"), SliceCount), 0, Megabytes, TEXT("MB") };
+			LoadBinary.Seconds = TimeBest(Runs, [&] { Cache->LoadBinary(BinaryFile); });
+
+			// Same steps as Save/Load, which always use the default file
+			const TOptional<FCloudPack> Pack = FCloudPack::ReadFromBinaryFile(BinaryFile);
+			const FString JsonFile = WorkDirectory / FString::Printf(TEXT("Pack%d.json"), SliceCount);
+			if (Pack.IsSet())
+			{
+				FBenchmarkResult& SaveJson = Results.AddDefaulted_GetRef();
+				SaveJson = { TEXT("CacheIO"), FString::Printf(TEXT("SaveJson_%d"), SliceCount), 0, Megabytes, TEXT("MB") };
+				SaveJson.Seconds = TimeBest(Runs, [&]
+				{
+					FCloudPack::WriteToFile(FCloudPack::Serialize(Pack->ToJsonObject({})), JsonFile);
+				});
+
+				FBenchmarkResult& LoadJson = Results.AddDefaulted_GetRef();
+				LoadJson = { TEXT("CacheIO"), FString::Printf(TEXT("LoadJson_%d"), SliceCount), 0, Megabytes, TEXT("MB") };
+				LoadJson.Seconds = TimeBest(Runs, [&]
+				{
+					FCloudPack::FromJsonObject(FCloudPack::Deserialize(FCloudPack::ReadFromFile(JsonFile)));
+				});
+			}
+
+			Cache->RemoveFromRoot();
+		}
+	}
+
+	void BenchmarkKernels(bool Quick, TArray<FBenchmarkResult>& Results)
+	{
+		constexpr int32 Size = 1024;
+		constexpr int32 Num = Size * Size;
+		const int32 Runs = Quick ? 5 : 20;
+
+		FRandomStream Random(4321);
+		TGenericDataArray<float> Array(Num, true, Size);
+		const TArrayView<float> Values = Array.GetWritableView(Num);
+		for (float& Value : Values)
+		{
+			Value = Random.FRand();
+		}
+
+		TArray<uint8> Output;
+		Output.SetNumUninitialized(Num * sizeof(FColor));
+		TArray<FColor> Lut;
+		Lut.Init(FColor::White, 256);
+
+		auto AddResult = [&Results, Num](const TCHAR* Name, double Seconds)
+		{
+			Results.Add({ TEXT("Kernels"), Name, Seconds, static_cast<double>(Num), TEXT("elements") });
+		};
+		AddResult(TEXT("QuantizeToUnorm8_1024"), TimeBest(Runs, [&]
+		{
+			FDataArrayKernels::QuantizeToUnorm8(Values.GetData(), Num, Output.GetData());
+		}));
+		AddResult(TEXT("ConvertToHalf_1024"), TimeBest(Runs, [&]
+		{
+			FDataArrayKernels::ConvertToHalf(Values.GetData(), Num, reinterpret_cast<uint16*>(Output.GetData()));
+		}));
+		AddResult(TEXT("ApplyTransferFunction_1024"), TimeBest(Runs, [&]
+		{
+			FDataArrayKernels::ApplyTransferFunction(Values.GetData(), Num, 255.f, 0.5f, Lut.GetData(),
+				reinterpret_cast<FColor*>(Output.GetData()));
+		}));
+		AddResult(TEXT("ResampleBilinear_256To1024"), TimeBest(Runs, [&]
+		{
+			FDataArrayKernels::ResampleBilinear(Values.GetData(), FIntPoint(256), reinterpret_cast<float*>(Output.GetData()),
+				FIntPoint(Size));
+		}));
+		AddResult(TEXT("ReduceMinMax_1024"), TimeBest(Runs, [&]
+		{
+			float Min, Max;
+			Array.ReduceMinMax(Min, Max);
+		}));
+	}
+
+	// Data array updates and upload packing of one texture, shared by the upload benchmark and the allocation check
+	struct FUploadSteps
+	{
+		static constexpr int32 Size = 1024;
+		static constexpr int32 Num = Size * Size;
+		// Scattered elements of the sparse update
+		static constexpr int32 SparseWrites = 64;
+
+		TArray<float> Values;
+		TGenericDataArray<float> Array { Num, true, Size };
+		FDataTextureUploadRing UploadRing;
+
+		FUploadSteps()
+		{
+			FRandomStream Random(8642);
+			Values.SetNumUninitialized(Num);
+			for (float& Value : Values)
+			{
+				Value = Random.FRand();
+			}
+		}
+
+		// Buffers of the array and every upload of the ring, steady-state updates must leave them unchanged
+		TArray<TPair<const void*, SIZE_T>> GetStorage() const
+		{
+			TArray<TPair<const void*, SIZE_T>> Storage;
+			Storage.Emplace(Array.GetData(), Array.GetAllocatedSize());
+			for (const FDataTextureUpload& Upload : UploadRing.GetUploads())
+			{
+				Storage.Emplace(Upload.Regions.GetData(), Upload.Regions.GetAllocatedSize());
+				Storage.Emplace(Upload.Pixels.GetData(), Upload.Pixels.GetAllocatedSize());
+				Storage.Emplace(Upload.DirtyRects.GetData(), Upload.DirtyRects.GetAllocatedSize());
+			}
+			return Storage;
+		}
+
+		// Calls Visit(Name, Items, Step) for every step
+		template <typename FVisitFunction>
+		void ForEachStep(FVisitFunction Visit)
+		{
+			Visit(TEXT("SetArray_1024"), Num, [this]
+			{
+				Array.SetArray(TConstArrayView<float>(Values));
+			});
+			Visit(TEXT("GetWritableView_1024"), Num, [this]
+			{
+				const TArrayView<float> View = Array.GetWritableView(Num);
+				FMemory::Memcpy(View.GetData(), Values.GetData(), Num * sizeof(float));
+			});
+			// Moved array smaller than Capacity is copied, so the full-size write after it keeps the storage
+			Visit(TEXT("MoveHalfThenWritableView_1024"), Num, [this]
+			{
+				Array.SetArray(TArray<float>(Values.GetData(), Num / 2));
+				const TArrayView<float> View = Array.GetWritableView(Num);
+				FMemory::Memcpy(View.GetData(), Values.GetData(), Num * sizeof(float));
+			});
+			Visit(TEXT("PackDirtyRegions_Float_1024"), Num, [this]
+			{
+				Array.MarkAllDirty();
+				Pack(sizeof(float), [](const float* Source, int32 Count, uint8* Destination)
+				{
+					FMemory::Memcpy(Destination, Source, Count * sizeof(float));
+				});
+			});
+			Visit(TEXT("PackDirtyRegions_R16F_1024"), Num, [this]
+			{
+				Array.MarkAllDirty();
+				Pack(sizeof(uint16), [](const float* Source, int32 Count, uint8* Destination)
+				{
+					FDataArrayKernels::ConvertToHalf(Source, Count, reinterpret_cast<uint16*>(Destination));
+				});
+			});
+			Visit(TEXT("PackDirtyRegions_Sparse_1024"), SparseWrites, [this]
+			{
+				for (int32 Write = 0; Write < SparseWrites; ++Write)
+				{
+					const int32 Index = Write * (Num / SparseWrites) + Write * 37;
+					Array.SetPlainArrayElement(Index, Values[Index]);
+				}
+				Pack(sizeof(float), [](const float* Source, int32 Count, uint8* Destination)
+				{
+					FMemory::Memcpy(Destination, Source, Count * sizeof(float));
+				});
+			});
+		}
+
+	private:
+		template <typename FConvertRow>
+		void Pack(uint32 PixelBytes, FConvertRow ConvertRow)
+		{
+			FDataTextureUpload& Upload = UploadRing.Acquire();
+			FDataTextureUploader::PackDirtyRegions(Array, Size, PixelBytes, FIntPoint::ZeroValue, ConvertRow, Upload);
+			Array.ClearDirty();
+		}
+	};
+
+	// Every upload of the ring is packed once before buffers reach their steady-state size
+	constexpr int32 UploadWarmupRuns = FDataTextureUploadRing::RingSize + 1;
+
+	void BenchmarkUpload(bool Quick, TArray<FBenchmarkResult>& Results)
+	{
+		const int32 Runs = Quick ? 5 : 20;
+		FUploadSteps Steps;
+		Steps.ForEachStep([&Results, Runs](const TCHAR* Name, double Items, auto Step)
+		{
+			for (int32 Run = 0; Run < UploadWarmupRuns; ++Run)
+			{
+				Step();
+			}
+			Results.Add({ TEXT("Upload"), Name, TimeBest(Runs, Step), Items, TEXT("elements") });
+		});
+	}
+
+	// Runs every upload step repeatedly after the warm-up and compares data pointers and allocated sizes of the
+	// array and the upload ring before and after; returns the number of steps that reallocated
+	int32 CheckUploadAllocations(int32 Runs)
+	{
+		FUploadSteps Steps;
+		int32 Failures = 0;
+		Steps.ForEachStep([&Steps, &Failures, Runs](const TCHAR* Name, double Items, auto Step)
+		{
+			for (int32 Run = 0; Run < UploadWarmupRuns; ++Run)
+			{
+				Step();
+			}
+			const TArray<TPair<const void*, SIZE_T>> Storage = Steps.GetStorage();
+			for (int32 Run = 0; Run < Runs; ++Run)
+			{
+				Step();
+			}
+			const bool Unchanged = Steps.GetStorage() == Storage;
+			Failures += Unchanged ? 0 : 1;
+			UE_LOG(LogTemp, Display, TEXT("GpuDataBenchmark: Upload/%-40s %s"), Name, Unchanged ? TEXT("no reallocation") : TEXT("REALLOCATED"));
+		});
+		return Failures;
+	}
+
+	// Throughput per result key
+	TMap<FString, double> ReadBaseline(const FString& FileName)
+	{
+		TMap<FString, double> Baseline;
+		FString Text;
+		TSharedPtr<FJsonObject> Root;
+		if (!FFileHelper::LoadFileToString(Text, *FileName) ||
+			!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Text), Root) || !Root)
+		{
+			return Baseline;
+		}
+		for (const TSharedPtr<FJsonValue>& Value : Root->GetArrayField(TEXT("Results")))
+		{
+			const TSharedPtr<FJsonObject> Result = Value->AsObject();
+			Baseline.Add(Result->GetStringField(TEXT("Group")) + TEXT("/") + Result->GetStringField(TEXT("Name")),
+				Result->GetNumberField(TEXT("Throughput")));
+		}
+		return Baseline;
+	}
+
+	bool WriteResults(const TArray<FBenchmarkResult>& Results, const TMap<FString, double>& Baseline,
+		const FString& JsonFile, const FString& CsvFile)
+	{
+		const TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+		TArray<TSharedPtr<FJsonValue>> JsonResults;
+		FString Csv = TEXT("Group,Name,Seconds,Items,Unit,Throughput,BaselineThroughput,MissesPerItem,CompressionRatio\n");
+		for (const FBenchmarkResult& Result : Results)
+		{
+			const double* BaselineThroughput = Baseline.Find(Result.GetKey());
+
+			const TSharedRef<FJsonObject> JsonResult = MakeShared<FJsonObject>();
+			JsonResult->SetStringField(TEXT("Group"), Result.Group);
+			JsonResult->SetStringField(TEXT("Name"), Result.Name);
+			JsonResult->SetNumberField(TEXT("Seconds"), Result.Seconds);
+			JsonResult->SetNumberField(TEXT("Items"), Result.Items);
+			JsonResult->SetStringField(TEXT("Unit"), Result.Unit);
+			JsonResult->SetNumberField(TEXT("Throughput"), Result.GetThroughput());
+			if (BaselineThroughput)
+			{
+				JsonResult->SetNumberField(TEXT("BaselineThroughput"), *BaselineThroughput);
+			}
+			if (Result.MissesPerItem >= 0)
+			{
+				JsonResult->SetNumberField(TEXT("MissesPerItem"), Result.MissesPerItem);
+			}
+			if (Result.CompressionRatio >= 0)
+			{
+				JsonResult->SetNumberField(TEXT("CompressionRatio"), Result.CompressionRatio);
+			}
+			JsonResults.Add(MakeShared<FJsonValueObject>(JsonResult));
+
+			Csv += FString::Printf(TEXT("%s,%s,%.6f,%.0f,%s,%.3f,%s,%s,%s\n"), *Result.Group, *Result.Name, Result.Seconds,
+				Result.Items, *Result.Unit, Result.GetThroughput(),
+				BaselineThroughput ? *FString::Printf(TEXT("%.3f"), *BaselineThroughput) : TEXT(""),
+				Result.MissesPerItem >= 0 ? *FString::Printf(TEXT("%.3f"), Result.MissesPerItem) : TEXT(""),
+				Result.CompressionRatio >= 0 ? *FString::Printf(TEXT("%.1f"), Result.CompressionRatio) : TEXT(""));
+		}
+		Root->SetArrayField(TEXT("Results"), JsonResults);
+		Root->SetStringField(TEXT("Cpu"), FPlatformMisc::GetCPUBrand());
+
+		FString Json;
+		FJsonSerializer::Serialize(Root, TJsonWriterFactory<>::Create(&Json));
+		return FFileHelper::SaveStringToFile(Json, *JsonFile) && FFileHelper::SaveStringToFile(Csv, *CsvFile);
+	}
+}
+
+UGpuDataBenchmarkCommandlet::UGpuDataBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UGpuDataBenchmarkCommandlet::Main(const FString& Params)
+{
+	const bool Quick = FParse::Param(*Params, TEXT("Quick"));
+	if (FParse::Param(*Params, TEXT("CheckAllocations")))
+	{
+		const int32 Failures = CheckUploadAllocations(Quick ? 10 : 100);
+		UE_LOG(LogTemp, Display, TEXT("GpuDataBenchmark: allocation check, %d steps reallocated"), Failures);
+		return Failures > 0 ? 1 : 0;
+	}
+	const bool UpdateBaseline = FParse::Param(*Params, TEXT("UpdateBaseline"));
+	const bool RequireBaseline = FParse::Param(*Params, TEXT("RequireBaseline"));
+
+	FString OutputDirectory = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / FDateTime::Now().ToString();
+	FParse::Value(*Params, TEXT("Output="), OutputDirectory);
+	FString BaselineFile = FPaths::ProjectDir() / TEXT("Benchmarks") / TEXT("GpuDataBaseline.json");
+	FParse::Value(*Params, TEXT("Baseline="), BaselineFile);
+	float Tolerance = 0.2f;
+	FParse::Value(*Params, TEXT("Tolerance="), Tolerance);
+
+	const FString WorkDirectory = OutputDirectory / TEXT("Work");
+	IFileManager::Get().MakeDirectory(*WorkDirectory, true);
+
+	TArray<FBenchmarkResult> Results;
+	if (UWorld* World = CreateBenchmarkWorld())
+	{
+		BenchmarkSlicer(World, Quick, Results);
+		World->DestroyWorld(false);
+		CollectGarbage(RF_NoFlags);
+	}
+	else
+	{
+		LOG_ERROR("Can't create benchmark world, slicer benchmarks are skipped");
+	}
+	BenchmarkCloudLayouts(Quick, Results);
+	BenchmarkCacheIO(WorkDirectory, Quick, Results);
+	BenchmarkKernels(Quick, Results);
+	BenchmarkUpload(Quick, Results);
+	IFileManager::Get().DeleteDirectory(*WorkDirectory, false, true);
+
+	const TMap<FString, double> Baseline = ReadBaseline(BaselineFile);
+	const FString JsonFile = OutputDirectory / TEXT("Results.json");
+	if (!WriteResults(Results, Baseline, JsonFile, OutputDirectory / TEXT("Results.csv")))
+	{
+		LOG_ERROR("Can't write results");
+		return 1;
+	}
+
+	int32 Regressions = 0;
+	// Results without baseline can't regress, they are reported so a missing baseline doesn't pass silently
+	int32 Unchecked = 0;
+	for (const FBenchmarkResult& Result : Results)
+	{
+		const double* BaselineThroughput = Baseline.Find(Result.GetKey());
+		const bool Regressed = BaselineThroughput && Result.GetThroughput() < *BaselineThroughput * (1.0 - Tolerance);
+		Regressions += Regressed ? 1 : 0;
+		Unchecked += BaselineThroughput ? 0 : 1;
+		UE_LOG(LogTemp, Display, TEXT("GpuDataBenchmark: %-40s %12.3f %s/s%s%s%s"), *Result.GetKey(), Result.GetThroughput(),
+			*Result.Unit, Result.MissesPerItem >= 0 ? *FString::Printf(TEXT("  %.3f misses/item"), Result.MissesPerItem) : TEXT(""),
+			Result.CompressionRatio >= 0 ? *FString::Printf(TEXT("  %.1fx compressed"), Result.CompressionRatio) : TEXT(""),
+			Regressed ? TEXT("  REGRESSION") : BaselineThroughput ? TEXT("") : TEXT("  no baseline"));
+	}
+	if (Baseline.IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("GpuDataBenchmark: no baseline in %s, regressions are not checked; record one on the "
+			"CI machine with -UpdateBaseline"), *BaselineFile);
+	}
+	else if (Unchecked > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("GpuDataBenchmark: %d results have no baseline in %s"), Unchecked, *BaselineFile);
+	}
+
+	if (UpdateBaseline && (!IFileManager::Get().MakeDirectory(*FPaths::GetPath(BaselineFile), true) ||
+		IFileManager::Get().Copy(*BaselineFile, *JsonFile) != COPY_OK))
+	{
+		LOG_ERROR("Can't update baseline");
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("GpuDataBenchmark: %d results, %d regressions, %d without baseline, written to %s"),
+		Results.Num(), Regressions, Unchecked, *OutputDirectory);
+	if (UpdateBaseline)
+	{
+		return 0;
+	}
+	return Regressions > 0 || (RequireBaseline && Unchecked > 0) ? 1 : 0;
+}
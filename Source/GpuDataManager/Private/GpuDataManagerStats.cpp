@@ -0,0 +1,133 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GpuDataManagerStats.h"
+#include <atomic>
+
+DEFINE_STAT(STAT_GpuData_GeneratePointCloud);
+DEFINE_STAT(STAT_GpuData_CalculateSlice);
+DEFINE_STAT(STAT_GpuData_CacheLookup);
+DEFINE_STAT(STAT_GpuData_Serialization);
+DEFINE_STAT(STAT_GpuData_TextureUpload);
+
+DEFINE_STAT(STAT_GpuData_PhysicsTraces);
+DEFINE_STAT(STAT_GpuData_CacheHits);
+DEFINE_STAT(STAT_GpuData_CacheMisses);
+DEFINE_STAT(STAT_GpuData_BytesSerialized);
+DEFINE_STAT(STAT_GpuData_TextureBytesUploaded);
+
+namespace
+{
+	std::atomic<int64> PhysicsTraces {0};
+	std::atomic<int64> CacheHits {0};
+	std::atomic<int64> CacheMisses {0};
+	std::atomic<int64> BytesSerialized {0};
+	std::atomic<int64> TextureBytesUploaded {0};
+	std::atomic<uint64> TimerCycles[static_cast<int32>(EGpuDataTimer::Num)] {};
+	thread_local FGpuDataManagerStats::FScopedTimer* CurrentTimer = nullptr;
+
+	float GetTimerMs(EGpuDataTimer Timer)
+	{
+		return static_cast<float>(FPlatformTime::ToMilliseconds64(TimerCycles[static_cast<int32>(Timer)].load(std::memory_order_relaxed)));
+	}
+}
+
+void FGpuDataManagerStats::AddPhysicsTraces(int64 Count)
+{
+	PhysicsTraces.fetch_add(Count, std::memory_order_relaxed);
+	INC_QWORD_STAT_BY(STAT_GpuData_PhysicsTraces, Count);
+}
+
+void FGpuDataManagerStats::AddCacheLookup(bool Hit)
+{
+	if (Hit)
+	{
+		CacheHits.fetch_add(1, std::memory_order_relaxed);
+		INC_DWORD_STAT(STAT_GpuData_CacheHits);
+	}
+	else
+	{
+		CacheMisses.fetch_add(1, std::memory_order_relaxed);
+		INC_DWORD_STAT(STAT_GpuData_CacheMisses);
+	}
+}
+
+void FGpuDataManagerStats::AddBytesSerialized(int64 Bytes)
+{
+	BytesSerialized.fetch_add(Bytes, std::memory_order_relaxed);
+	INC_QWORD_STAT_BY(STAT_GpuData_BytesSerialized, Bytes);
+}
+
+void FGpuDataManagerStats::AddTextureBytesUploaded(int64 Bytes)
+{
+	TextureBytesUploaded.fetch_add(Bytes, std::memory_order_relaxed);
+	INC_QWORD_STAT_BY(STAT_GpuData_TextureBytesUploaded, Bytes);
+}
+
+void FGpuDataManagerStats::AddTime(EGpuDataTimer Timer, uint64 Cycles)
+{
+	TimerCycles[static_cast<int32>(Timer)].fetch_add(Cycles, std::memory_order_relaxed);
+}
+
+FGpuDataManagerStats::FScopedTimer::FScopedTimer(EGpuDataTimer InTimer)
+	: Timer(InTimer)
+	, StartCycles(FPlatformTime::Cycles64())
+	, Parent(CurrentTimer)
+{
+	if (Parent)
+	{
+		// Enclosing scope keeps what it has run so far and resumes when this one ends
+		AddTime(Parent->Timer, StartCycles - Parent->StartCycles);
+	}
+	CurrentTimer = this;
+}
+
+FGpuDataManagerStats::FScopedTimer::~FScopedTimer()
+{
+	const uint64 EndCycles = FPlatformTime::Cycles64();
+	AddTime(Timer, EndCycles - StartCycles);
+	CurrentTimer = Parent;
+	if (Parent)
+	{
+		Parent->StartCycles = EndCycles;
+	}
+}
+
+FGpuDataManagerStatsSnapshot FGpuDataManagerStats::GetSnapshot()
+{
+	FGpuDataManagerStatsSnapshot Snapshot;
+	Snapshot.PhysicsTraces = PhysicsTraces.load(std::memory_order_relaxed);
+	Snapshot.CacheHits = CacheHits.load(std::memory_order_relaxed);
+	Snapshot.CacheMisses = CacheMisses.load(std::memory_order_relaxed);
+	Snapshot.BytesSerialized = BytesSerialized.load(std::memory_order_relaxed);
+	Snapshot.TextureBytesUploaded = TextureBytesUploaded.load(std::memory_order_relaxed);
+	Snapshot.GenerationMs = GetTimerMs(EGpuDataTimer::Generation);
+	Snapshot.SlicingMs = GetTimerMs(EGpuDataTimer::Slicing);
+	Snapshot.CacheLookupMs = GetTimerMs(EGpuDataTimer::CacheLookup);
+	Snapshot.SerializationMs = GetTimerMs(EGpuDataTimer::Serialization);
+	Snapshot.TextureUploadMs = GetTimerMs(EGpuDataTimer::TextureUpload);
+	return Snapshot;
+}
+
+void FGpuDataManagerStats::Reset()
+{
+	PhysicsTraces = 0;
+	CacheHits = 0;
+	CacheMisses = 0;
+	BytesSerialized = 0;
+	TextureBytesUploaded = 0;
+	for (std::atomic<uint64>& Cycles : TimerCycles)
+	{
+		Cycles = 0;
+	}
+}
+
+FGpuDataManagerStatsSnapshot UGpuDataManagerStatsLibrary::GetGpuDataManagerStats()
+{
+	return FGpuDataManagerStats::GetSnapshot();
+}
+
+void UGpuDataManagerStatsLibrary::ResetGpuDataManagerStats()
+{
+	FGpuDataManagerStats::Reset();
+}
@@ -0,0 +1,218 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SliceRelatedTypes.h"
+#include "Algo/Reverse.h"
+#include "Hash/xxhash.h"
+
+namespace
+{
+	// Cell edges: 0 bottom, 1 right, 2 top, 3 left; corner bits: 1 bottom-left, 2 bottom-right, 4 top-right, 8 top-left
+	// Saddles 5 and 10 isolate the inside corners, the other saddle's row is used when the center is inside
+	constexpr int8 SegmentTable[16][4] = {
+		{ -1, -1, -1, -1 },
+		{ 3, 0, -1, -1 },
+		{ 0, 1, -1, -1 },
+		{ 3, 1, -1, -1 },
+		{ 1, 2, -1, -1 },
+		{ 3, 0, 1, 2 },
+		{ 0, 2, -1, -1 },
+		{ 3, 2, -1, -1 },
+		{ 2, 3, -1, -1 },
+		{ 0, 2, -1, -1 },
+		{ 0, 1, 2, 3 },
+		{ 1, 2, -1, -1 },
+		{ 1, 3, -1, -1 },
+		{ 0, 1, -1, -1 },
+		{ 3, 0, -1, -1 },
+		{ -1, -1, -1, -1 }
+	};
+
+	struct FContourGrid
+	{
+		const FSlice& Slice;
+		float IsoValue;
+
+		// Same layout UActorSlicer writes slices with
+		float GetValue(int32 X, int32 Y) const
+		{
+			return Slice.Data[Y * Slice.Resolution.X + X];
+		}
+
+		// Horizontal edge (X, Y)-(X + 1, Y) is 2 * Cell, vertical edge (X, Y)-(X, Y + 1) is 2 * Cell + 1
+		int32 GetEdgeId(int32 X, int32 Y, int32 CellEdge) const
+		{
+			switch (CellEdge)
+			{
+			case 0:
+				return 2 * (Y * Slice.Resolution.X + X);
+			case 1:
+				return 2 * (Y * Slice.Resolution.X + X + 1) + 1;
+			case 2:
+				return 2 * ((Y + 1) * Slice.Resolution.X + X);
+			default:
+				return 2 * (Y * Slice.Resolution.X + X) + 1;
+			}
+		}
+
+		// Iso crossing on the edge in plane space
+		FVector2D GetEdgePoint(int32 EdgeId) const
+		{
+			const int32 Cell = EdgeId / 2;
+			const int32 X = Cell % Slice.Resolution.X;
+			const int32 Y = Cell / Slice.Resolution.X;
+			const bool Vertical = EdgeId % 2 == 1;
+			const float A = GetValue(X, Y);
+			const float B = Vertical ? GetValue(X, Y + 1) : GetValue(X + 1, Y);
+			const float Alpha = FMath::IsNearlyEqual(A, B) ? 0.5f : FMath::Clamp((IsoValue - A) / (B - A), 0.f, 1.f);
+
+			const FVector2D GridPoint(X + (Vertical ? 0.f : Alpha), Y + (Vertical ? Alpha : 0.f));
+			const FVector2D Cells(Slice.Resolution.X - 1, Slice.Resolution.Y - 1);
+			return (GridPoint / Cells - 0.5) * Slice.PhysicalSize;
+		}
+	};
+}
+
+FArchive& operator<<(FArchive& Ar, FSliceContour& Contour)
+{
+	Ar << Contour.Points;
+	Ar << Contour.bClosed;
+	return Ar;
+}
+
+FSliceContours FSliceContours::Extract(const FSlice& Slice, float IsoValue)
+{
+	FSliceContours Result;
+	Result.PhysicalSize = Slice.PhysicalSize;
+	Result.IsoValue = IsoValue;
+	if (Slice.Resolution.X < 2 || Slice.Resolution.Y < 2 || Slice.Data.Num() < Slice.Resolution.X * Slice.Resolution.Y)
+	{
+		return Result;
+	}
+
+	// Segments as pairs of edge ids, joined into polylines through shared edges
+	const FContourGrid Grid { Slice, IsoValue };
+	TArray<TPair<int32, int32>> Segments;
+	TMap<int32, TArray<int32, TInlineAllocator<2>>> EdgeSegments;
+	for (int32 Y = 0; Y + 1 < Slice.Resolution.Y; ++Y)
+	{
+		for (int32 X = 0; X + 1 < Slice.Resolution.X; ++X)
+		{
+			const float BottomLeft = Grid.GetValue(X, Y);
+			const float BottomRight = Grid.GetValue(X + 1, Y);
+			const float TopRight = Grid.GetValue(X + 1, Y + 1);
+			const float TopLeft = Grid.GetValue(X, Y + 1);
+			int32 Case = (BottomLeft >= IsoValue ? 1 : 0) | (BottomRight >= IsoValue ? 2 : 0) |
+				(TopRight >= IsoValue ? 4 : 0) | (TopLeft >= IsoValue ? 8 : 0);
+			if ((Case == 5 || Case == 10) && (BottomLeft + BottomRight + TopRight + TopLeft) / 4.f >= IsoValue)
+			{
+				// Connected saddle separates the other pair of corners
+				Case = 15 - Case;
+			}
+
+			const int8* CellSegments = SegmentTable[Case];
+			for (int32 Index = 0; Index < 4 && CellSegments[Index] >= 0; Index += 2)
+			{
+				const int32 SegmentIndex = Segments.Emplace(Grid.GetEdgeId(X, Y, CellSegments[Index]),
+					Grid.GetEdgeId(X, Y, CellSegments[Index + 1]));
+				EdgeSegments.FindOrAdd(Segments[SegmentIndex].Key).Add(SegmentIndex);
+				EdgeSegments.FindOrAdd(Segments[SegmentIndex].Value).Add(SegmentIndex);
+			}
+		}
+	}
+
+	TBitArray<> UsedSegments(false, Segments.Num());
+	// Appends edges connected to Chain.Last(), true when the chain came back to its first edge
+	auto Extend = [&](TArray<int32>& Chain) -> bool
+	{
+		while (true)
+		{
+			const int32 Edge = Chain.Last();
+			int32 NextEdge = INDEX_NONE;
+			for (const int32 SegmentIndex : EdgeSegments.FindChecked(Edge))
+			{
+				if (!UsedSegments[SegmentIndex])
+				{
+					UsedSegments[SegmentIndex] = true;
+					const TPair<int32, int32>& Segment = Segments[SegmentIndex];
+					NextEdge = Segment.Key == Edge ? Segment.Value : Segment.Key;
+					break;
+				}
+			}
+			if (NextEdge == INDEX_NONE)
+			{
+				return false;
+			}
+			if (NextEdge == Chain[0])
+			{
+				return true;
+			}
+			Chain.Add(NextEdge);
+		}
+	};
+
+	TArray<int32> Chain;
+	for (int32 SegmentIndex = 0; SegmentIndex < Segments.Num(); ++SegmentIndex)
+	{
+		if (UsedSegments[SegmentIndex])
+		{
+			continue;
+		}
+		UsedSegments[SegmentIndex] = true;
+		Chain.Reset();
+		Chain.Add(Segments[SegmentIndex].Key);
+		Chain.Add(Segments[SegmentIndex].Value);
+
+		FSliceContour& Contour = Result.Contours.AddDefaulted_GetRef();
+		Contour.bClosed = Extend(Chain);
+		if (!Contour.bClosed)
+		{
+			// Open line touches the slice border on both ends
+			Algo::Reverse(Chain);
+			Extend(Chain);
+		}
+
+		Contour.Points.Reserve(Chain.Num());
+		for (const int32 Edge : Chain)
+		{
+			Contour.Points.Add(Grid.GetEdgePoint(Edge));
+		}
+	}
+	return Result;
+}
+
+FString FSliceContours::GetContentHash() const
+{
+	FXxHash64Builder Builder;
+	Builder.Update(&PhysicalSize, sizeof(PhysicalSize));
+	Builder.Update(&IsoValue, sizeof(IsoValue));
+	for (const FSliceContour& Contour : Contours)
+	{
+		Builder.Update(&Contour.bClosed, sizeof(Contour.bClosed));
+		Builder.Update(Contour.Points.GetData(), Contour.Points.Num() * Contour.Points.GetTypeSize());
+	}
+	return FString::Printf(TEXT("%016llx"), Builder.Finalize().Hash);
+}
+
+bool FSliceContours::operator==(const FSliceContours& Other) const
+{
+	return PhysicalSize == Other.PhysicalSize && IsoValue == Other.IsoValue && Contours == Other.Contours;
+}
+
+SIZE_T FSliceContours::GetAllocatedSize() const
+{
+	SIZE_T Size = Contours.GetAllocatedSize();
+	for (const FSliceContour& Contour : Contours)
+	{
+		Size += Contour.Points.GetAllocatedSize();
+	}
+	return Size;
+}
+
+FArchive& operator<<(FArchive& Ar, FSliceContours& Contours)
+{
+	Ar << Contours.PhysicalSize;
+	Ar << Contours.IsoValue;
+	Ar << Contours.Contours;
+	return Ar;
+}
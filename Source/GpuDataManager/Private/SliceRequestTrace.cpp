@@ -0,0 +1,202 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SliceRequestTrace.h"
+#include "Algo/Transform.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+
+#define LOG_ERROR(ErrorText) UE_LOG(LogTemp, Warning, TEXT("SliceRequestTrace %s: %s"), *FString(__func__), *FString(ErrorText));
+
+namespace
+{
+	constexpr uint32 SliceTraceBinaryMagic = 0x52544C53; // "SLTR"
+	constexpr uint32 SliceTraceBinaryVersion = 1;
+
+	void SerializeRecord(FArchive& Ar, FSliceRequestRecord& Record, TArray<FName>& Names, TMap<FName, int32>& NameIndices)
+	{
+		uint8 Kind = static_cast<uint8>(Record.Kind);
+		Ar << Kind;
+		Record.Kind = static_cast<ESliceRequestKind>(FMath::Min<uint8>(Kind, static_cast<uint8>(ESliceRequestKind::Num)));
+		Ar << Record.Timestamp;
+
+		// Tags as packed indices into the name table
+		uint32 CloudTagIndex = Ar.IsSaving() ? NameIndices.FindChecked(Record.CloudTag) : 0;
+		uint32 SliceTagIndex = Ar.IsSaving() ? NameIndices.FindChecked(Record.SliceTag) : 0;
+		Ar.SerializeIntPacked(CloudTagIndex);
+		Ar.SerializeIntPacked(SliceTagIndex);
+		if (Ar.IsLoading())
+		{
+			Record.CloudTag = Names.IsValidIndex(CloudTagIndex) ? Names[CloudTagIndex] : NAME_None;
+			Record.SliceTag = Names.IsValidIndex(SliceTagIndex) ? Names[SliceTagIndex] : NAME_None;
+		}
+
+		if (Record.Kind == ESliceRequestKind::GetSliceFromStack)
+		{
+			uint32 StackIndex = static_cast<uint32>(FMath::Max(Record.StackIndex, 0));
+			Ar.SerializeIntPacked(StackIndex);
+			Record.StackIndex = static_cast<int32>(StackIndex);
+		}
+		else if (Record.Kind == ESliceRequestKind::CalculateOrLoadSlice)
+		{
+			Ar << Record.PlaneOrigin << Record.PlaneRotation;
+			Ar << Record.PointCloudExtent << Record.PointCloudRotation << Record.PointCloudOrigin;
+			Ar << Record.ImagePhysicalSize << Record.TargetImageSize;
+		}
+
+		Ar << Record.Hit;
+		Ar << Record.LatencyMs;
+	}
+}
+
+const TCHAR* LexToString(ESliceRequestKind Kind)
+{
+	switch (Kind)
+	{
+	case ESliceRequestKind::CalculateOrLoadSlice:
+		return TEXT("CalculateOrLoadSlice");
+	case ESliceRequestKind::GetSlice:
+		return TEXT("GetSlice");
+	case ESliceRequestKind::FindSlice:
+		return TEXT("FindSlice");
+	case ESliceRequestKind::GetSliceFromStack:
+		return TEXT("GetSliceFromStack");
+	case ESliceRequestKind::GetCloud:
+		return TEXT("GetCloud");
+	case ESliceRequestKind::GetCloudWithSlices:
+		return TEXT("GetCloudWithSlices");
+	default:
+		return TEXT("Unknown");
+	}
+}
+
+bool FSliceRequestTrace::WriteToFile(const FString& FileName) const
+{
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*FileName));
+	if (!Writer)
+	{
+		LOG_ERROR("Can't open file for writing");
+		return false;
+	}
+
+	TArray<FName> Names;
+	TMap<FName, int32> NameIndices;
+	for (const FSliceRequestRecord& Record : Records)
+	{
+		for (const FName& Tag : { Record.CloudTag, Record.SliceTag })
+		{
+			if (!NameIndices.Contains(Tag))
+			{
+				NameIndices.Add(Tag, Names.Add(Tag));
+			}
+		}
+	}
+
+	uint32 Magic = SliceTraceBinaryMagic;
+	uint32 Version = SliceTraceBinaryVersion;
+	*Writer << Magic << Version;
+
+	TArray<FString> NameStrings;
+	Algo::Transform(Names, NameStrings, [](const FName& Name) { return Name.ToString(); });
+	*Writer << NameStrings;
+
+	int32 RecordCount = Records.Num();
+	*Writer << RecordCount;
+	for (const FSliceRequestRecord& Record : Records)
+	{
+		// Saving archive does not modify the record
+		SerializeRecord(*Writer, const_cast<FSliceRequestRecord&>(Record), Names, NameIndices);
+	}
+	return Writer->Close();
+}
+
+TOptional<FSliceRequestTrace> FSliceRequestTrace::ReadFromFile(const FString& FileName)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *FileName, FILEREAD_Silent))
+	{
+		LOG_ERROR("Can't read trace file");
+		return {};
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	Reader << Magic << Version;
+	if (Magic != SliceTraceBinaryMagic || Version != SliceTraceBinaryVersion)
+	{
+		LOG_ERROR("Unknown slice trace format");
+		return {};
+	}
+
+	TArray<FString> NameStrings;
+	Reader << NameStrings;
+	TArray<FName> Names;
+	Algo::Transform(NameStrings, Names, [](const FString& Name) { return FName(*Name); });
+
+	int32 RecordCount = 0;
+	Reader << RecordCount;
+	if (Reader.IsError() || RecordCount < 0)
+	{
+		LOG_ERROR("Corrupted slice trace");
+		return {};
+	}
+
+	FSliceRequestTrace Trace;
+	TMap<FName, int32> NameIndices;
+	for (int32 Index = 0; Index < RecordCount && !Reader.IsError(); ++Index)
+	{
+		FSliceRequestRecord& Record = Trace.Records.AddDefaulted_GetRef();
+		SerializeRecord(Reader, Record, Names, NameIndices);
+		if (Record.Kind == ESliceRequestKind::Num)
+		{
+			Reader.SetError();
+		}
+	}
+	if (Reader.IsError())
+	{
+		LOG_ERROR("Corrupted slice trace");
+		return {};
+	}
+	return Trace;
+}
+
+FSliceRequestRecorder::FSliceRequestRecorder()
+	: StartSeconds(FPlatformTime::Seconds())
+{
+}
+
+FSliceRequestRecorder::FScopedRequest::FScopedRequest(FSliceRequestRecorder* InRecorder, ESliceRequestKind Kind)
+{
+	if (InRecorder && InRecorder->Depth++ == 0)
+	{
+		Recorder = InRecorder;
+		StartSeconds = FPlatformTime::Seconds();
+		Record.Kind = Kind;
+	}
+	else
+	{
+		// Nested request only keeps depth balanced
+		NestedRecorder = InRecorder;
+	}
+}
+
+FSliceRequestRecorder::FScopedRequest::~FScopedRequest()
+{
+	if (NestedRecorder)
+	{
+		--NestedRecorder->Depth;
+		return;
+	}
+	if (!Recorder)
+	{
+		return;
+	}
+
+	const double EndSeconds = FPlatformTime::Seconds();
+	Record.Timestamp = StartSeconds - Recorder->StartSeconds;
+	Record.LatencyMs = static_cast<float>((EndSeconds - StartSeconds) * 1000.0);
+	Recorder->Trace.Records.Add(MoveTemp(Record));
+	--Recorder->Depth;
+}
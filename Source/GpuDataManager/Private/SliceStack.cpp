@@ -0,0 +1,179 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SliceRelatedTypes.h"
+#include "Hash/xxhash.h"
+
+namespace
+{
+	// Token word: high bit set - run of zero words, otherwise number of literal words that follow
+	constexpr uint32 ZeroRunFlag = 0x80000000u;
+
+	void EncodeWords(const uint32* Src, int32 Num, TArray<uint32>& Out)
+	{
+		int32 Index = 0;
+		while (Index < Num)
+		{
+			int32 RunEnd = Index;
+			while (RunEnd < Num && Src[RunEnd] == 0)
+			{
+				++RunEnd;
+			}
+			if (RunEnd > Index)
+			{
+				Out.Add(ZeroRunFlag | static_cast<uint32>(RunEnd - Index));
+				Index = RunEnd;
+				continue;
+			}
+
+			// Literal run ends at the first pair of zero words, single zeros are cheaper inline
+			while (RunEnd < Num && !(Src[RunEnd] == 0 && RunEnd + 1 < Num && Src[RunEnd + 1] == 0))
+			{
+				++RunEnd;
+			}
+			Out.Add(static_cast<uint32>(RunEnd - Index));
+			Out.Append(Src + Index, RunEnd - Index);
+			Index = RunEnd;
+		}
+	}
+
+	// Xor decoded words into Dst, keyframes are decoded into zeroed Dst
+	bool DecodeWordsXor(const uint32* Src, int32 SrcNum, uint32* Dst, int32 DstNum)
+	{
+		int32 SrcIndex = 0;
+		int32 DstIndex = 0;
+		while (SrcIndex < SrcNum)
+		{
+			const uint32 Token = Src[SrcIndex++];
+			const int32 RunLength = static_cast<int32>(Token & ~ZeroRunFlag);
+			if (DstIndex + RunLength > DstNum)
+			{
+				return false;
+			}
+			if (Token & ZeroRunFlag)
+			{
+				DstIndex += RunLength;
+				continue;
+			}
+			if (SrcIndex + RunLength > SrcNum)
+			{
+				return false;
+			}
+			for (int32 I = 0; I < RunLength; ++I)
+			{
+				Dst[DstIndex++] ^= Src[SrcIndex++];
+			}
+		}
+		return DstIndex == DstNum;
+	}
+}
+
+bool FSliceStack::Add(const FSlice& Slice)
+{
+	static_assert(sizeof(float) == sizeof(uint32));
+
+	if (Slice.Data.Num() != Slice.Resolution.X * Slice.Resolution.Y)
+	{
+		return false;
+	}
+	if (Num() == 0)
+	{
+		PhysicalSize = Slice.PhysicalSize;
+		Resolution = Slice.Resolution;
+	}
+	else if (Slice.Resolution != Resolution || Slice.PhysicalSize != PhysicalSize)
+	{
+		return false;
+	}
+
+	const int32 WordsNum = Slice.Data.Num();
+	const uint32* SliceWords = reinterpret_cast<const uint32*>(Slice.Data.GetData());
+	const bool IsKeyframe = KeyframeInterval <= 1 || Num() % KeyframeInterval == 0;
+
+	if (!IsKeyframe && Tail.Num() != WordsNum)
+	{
+		FSlice Previous;
+		if (!GetSlice(Num() - 1, Previous) || Previous.Data.Num() != WordsNum)
+		{
+			return false;
+		}
+		Tail.SetNumUninitialized(WordsNum);
+		FMemory::Memcpy(Tail.GetData(), Previous.Data.GetData(), WordsNum * sizeof(uint32));
+	}
+
+	Offsets.Add(Words.Num());
+	if (IsKeyframe)
+	{
+		EncodeWords(SliceWords, WordsNum, Words);
+		Tail.SetNumUninitialized(WordsNum);
+		FMemory::Memcpy(Tail.GetData(), SliceWords, WordsNum * sizeof(uint32));
+		return true;
+	}
+
+	// Tail becomes the delta, then the new slice
+	for (int32 I = 0; I < WordsNum; ++I)
+	{
+		Tail[I] ^= SliceWords[I];
+	}
+	EncodeWords(Tail.GetData(), WordsNum, Words);
+	FMemory::Memcpy(Tail.GetData(), SliceWords, WordsNum * sizeof(uint32));
+	return true;
+}
+
+bool FSliceStack::GetSlice(int32 Index, FSlice& OutSlice) const
+{
+	if (!Offsets.IsValidIndex(Index))
+	{
+		return false;
+	}
+
+	const int32 WordsNum = Resolution.X * Resolution.Y;
+	TArray<float> Data;
+	Data.SetNumZeroed(WordsNum);
+	uint32* DataWords = reinterpret_cast<uint32*>(Data.GetData());
+
+	const int32 Keyframe = KeyframeInterval <= 1 ? Index : Index - Index % KeyframeInterval;
+	for (int32 Current = Keyframe; Current <= Index; ++Current)
+	{
+		const int32 Begin = Offsets[Current];
+		const int32 End = Offsets.IsValidIndex(Current + 1) ? Offsets[Current + 1] : Words.Num();
+		if (!DecodeWordsXor(Words.GetData() + Begin, End - Begin, DataWords, WordsNum))
+		{
+			return false;
+		}
+	}
+
+	OutSlice = FSlice(std::move(Data), PhysicalSize, Resolution);
+	return true;
+}
+
+FString FSliceStack::GetContentHash() const
+{
+	FXxHash64Builder Builder;
+	Builder.Update(&PhysicalSize, sizeof(PhysicalSize));
+	Builder.Update(&Resolution, sizeof(Resolution));
+	Builder.Update(&KeyframeInterval, sizeof(KeyframeInterval));
+	Builder.Update(Offsets.GetData(), Offsets.Num() * Offsets.GetTypeSize());
+	Builder.Update(Words.GetData(), Words.Num() * Words.GetTypeSize());
+	return FString::Printf(TEXT("%016llx"), Builder.Finalize().Hash);
+}
+
+bool FSliceStack::operator==(const FSliceStack& Other) const
+{
+	return PhysicalSize == Other.PhysicalSize && Resolution == Other.Resolution &&
+		KeyframeInterval == Other.KeyframeInterval && Offsets == Other.Offsets && Words == Other.Words;
+}
+
+FArchive& operator<<(FArchive& Ar, FSliceStack& Stack)
+{
+	Ar << Stack.PhysicalSize;
+	Ar << Stack.Resolution;
+	Ar << Stack.KeyframeInterval;
+	Stack.Offsets.BulkSerialize(Ar);
+	Stack.Words.BulkSerialize(Ar);
+	if (Ar.IsLoading())
+	{
+		Stack.Tail.Empty();
+	}
+	return Ar;
+}
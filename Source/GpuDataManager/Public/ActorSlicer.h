@@ -6,8 +6,70 @@
 #include "Components/ActorComponent.h"
 #include "SliceRelatedTypes.h"
 #include "CloudCache.h"
+#include "Components/LineBatchComponent.h"
 #include "ActorSlicer.generated.h"
 
+struct FTraceDatum;
+struct FTraceHandle;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnPointCloudGenerated, FName, CloudCacheTag);
+
+UENUM(BlueprintType)
+enum class EPointCloudGenerationMode : uint8
+{
+	// Blocking traces on the game thread within GenerationBudgetMs per tick
+	TimeSliced,
+	// Batches of async traces run by physics, results are collected on later frames
+	AsyncTraces
+};
+
+// Slice computed by the CloudCacheBake commandlet, locations are relative to the owner actor
+USTRUCT(BlueprintType)
+struct FSliceBakeRequest
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FName SliceTag {};
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector PlaneOrigin { FVector::ZeroVector };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FRotator PlaneRotation { FRotator::ZeroRotator };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector2D ImagePhysicalSize { 100, 100 };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FIntPoint TargetImageSize { 64, 64 };
+};
+
+// Cloud and slices computed by the CloudCacheBake commandlet, locations are relative to the owner actor
+USTRUCT(BlueprintType)
+struct FSlicerBakeSettings
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bBake = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FName CloudCacheTag {};
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector BoxLocation { FVector::ZeroVector };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector BoxExtent { 100, 100, 100 };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FIntVector PointDensity { 32, 32, 32 };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<FSliceBakeRequest> Slices {};
+};
+
 /*
  * @USAGE
  *
@@ -15,6 +77,7 @@
  * Add as actor component
  * Set pointer to global cache by SetCachePointer
  * Generate new point cloud by GenerateOrLoadPointCloud
+ * or spread generation over frames by StartPointCloudGeneration, watch GetGenerationProgress/OnPointCloudGenerated
  * Calculate slice by CalculateOrLoadSliceOnPlane
  * 
  */
@@ -45,6 +108,54 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void GeneratePointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent, const FIntVector PointDensity);
 
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Generate cloud of every object in the box in one pass, points are labeled by the actor or physical material they are inside; stores labeled cloud and its plain mask to the cache"))
+	void GenerateLabeledPointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent, const FIntVector PointDensity,
+		EVoxelLabelSource LabelSource = EVoxelLabelSource::Actor);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Generate point cloud during ticks and store it to the cache when finished, replaces running generation"))
+	bool StartPointCloudGeneration(FVector SlicerBoxLocation, FVector SlicerBoxExtent, const FIntVector PointDensity,
+		EPointCloudGenerationMode Mode = EPointCloudGenerationMode::TimeSliced);
+
+	UFUNCTION(BlueprintCallable)
+	void CancelPointCloudGeneration();
+
+	UFUNCTION(BlueprintCallable)
+	bool IsGeneratingPointCloud() const;
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Part of points of the running generation already traced, from 0 to 1"))
+	float GetGenerationProgress() const;
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Cloud of the running generation, points not traced yet are false; Success is false when nothing is generated"))
+	FPointCloud GetPartialPointCloud(bool &Success) const;
+
+	UPROPERTY(BlueprintAssignable,
+		meta=(ToolTip="Called when generation started by StartPointCloudGeneration is finished and stored to the cache"))
+	FOnPointCloudGenerated OnPointCloudGenerated;
+
+	// Keep generated clouds run-length encoded in the cache, slicing decodes only the rows it touches
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bCompressClouds = false;
+
+	// Layout of plain clouds stored to the cache, Bricks makes oblique slicing cache friendly
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EPointCloudLayout CloudLayout = EPointCloudLayout::Linear;
+
+	// Time of each tick spent on StartPointCloudGeneration, at least one point is traced per tick
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta=(ClampMin=0.1))
+	float GenerationBudgetMs = 2.f;
+
+	// Points whose async traces may be in flight at once, in AsyncTraces generation mode
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta=(ClampMin=1))
+	int32 AsyncTraceBatchSize = 4096;
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Hash of box, density and transforms/mesh assets of actors overlapping the box; cached cloud is regenerated when it changes"))
+	FString CalculateGenerationKey(FVector SlicerBoxLocation, FVector SlicerBoxExtent, const FIntVector PointDensity) const;
+
 	UFUNCTION(BlueprintCallable)
 	bool IsCacheSet() const;
 
@@ -62,7 +173,21 @@ public:
 		const FIntPoint& TargetImageSize
 	) const;
 
-	UFUNCTION(BlueprintCallable)
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Slice of the labeled cloud; empty LabelName gives label of the closest point per pixel to colorize with DataManager TransferFunction, otherwise only points of LabelName are sliced like in CalculateSliceOnPlane"))
+	FSlice CalculateLabeledSliceOnPlane(
+		const FVector& PlaneOrigin,
+		const FRotator& PlaneRotation,
+		const FVector& PointCloudExtent,
+		const FRotator& PointCloudRotation,
+		const FVector& PointCloudOrigin,
+		const FVector2D& ImagePhysicalSize,
+		const FIntPoint& TargetImageSize,
+		const FString& LabelName
+	) const;
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Slice stored by SliceTag, calculated and cached when missing; WasCached is true when the cache served it"))
 	FSlice CalculateOrLoadSliceOnPlane(
 		const FVector& PlaneOrigin,
 		const FRotator& PlaneRotation,
@@ -71,18 +196,100 @@ public:
 		const FVector& PointCloudOrigin,
 		const FVector2D& ImagePhysicalSize,
 		const FIntPoint& TargetImageSize,
-		const FName& SliceTag
+		const FName& SliceTag,
+		bool& WasCached
+	);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Contours of the slice stored by SliceTag, slice and contours are calculated and cached when missing"))
+	FSliceContours CalculateOrLoadSliceContours(
+		const FVector& PlaneOrigin,
+		const FRotator& PlaneRotation,
+		const FVector& PointCloudExtent,
+		const FRotator& PointCloudRotation,
+		const FVector& PointCloudOrigin,
+		const FVector2D& ImagePhysicalSize,
+		const FIntPoint& TargetImageSize,
+		const FName& SliceTag,
+		float IsoValue = 128.f
 	);
 
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Draw contours on the slicing plane with a line batch owned by the slicer, same plane arguments as for the slice"))
+	void DrawSliceContours(const FSliceContours& Contours, const FVector& PlaneOrigin, const FRotator& PlaneRotation,
+		const FVector& PointCloudOrigin, FLinearColor Color = FLinearColor::Green, float Thickness = 1.f, float LifeTime = 0.f);
+
+	UFUNCTION(BlueprintCallable)
+	void ClearSliceContours();
+
 	UFUNCTION(BlueprintCallable)
 	void CacheSlice(FSlice Slice, FName SliceTag);
 
 	UFUNCTION(BlueprintCallable)
 	FString SliceToString(const FSlice &Src);
 
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Generate cloud and declared slices from BakeSettings into TargetCache, used by the CloudCacheBake commandlet"))
+	bool Bake(UCloudCache* TargetCache);
+
 	FPointCloud GeneratePointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent, FIntVector PointDensity, bool DrawDebugInfo = false) const;
+
+	// GeneratePointCloud emitting runs directly
+	FRlePointCloud TraceCompressedPointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent, FIntVector PointDensity) const;
+
+	FLabeledPointCloud TraceLabeledPointCloud(FVector SlicerBoxLocation, FVector SlicerBoxExtent, FIntVector PointDensity,
+		EVoxelLabelSource LabelSource) const;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FSlicerBakeSettings BakeSettings {};
 	
 private:
+	struct FPendingPoint
+	{
+		int64 PointIndex = 0;
+		// Bit 0/1 low/up trace hit, bit 2/3 low/up trace done
+		uint8 TraceMask = 0;
+	};
+
+	// State of StartPointCloudGeneration kept between ticks
+	struct FGenerationJob
+	{
+		EPointCloudGenerationMode Mode = EPointCloudGenerationMode::TimeSliced;
+		uint32 Serial = 0;
+		FVector Min;
+		FVector Max;
+		FVector Step;
+		// Next point to trace, X changes fastest like in FPointCloud
+		FIntVector Cursor;
+		FPointCloud Cloud;
+		FString GenerationKey;
+		int64 CompletedPoints = 0;
+		int64 TruePointsCount = 0;
+		// AsyncTraces mode, points with traces in flight; trace user data is slot index and side
+		TArray<FPendingPoint> PendingPoints;
+		TArray<int32> FreePendingSlots;
+		int32 PendingTraces = 0;
+	};
+
+	// Traces from both box sides towards the point, the point is inside when both traces hit
+	bool IsPointInside(const FVector& TestPoint, const FVector& Min, const FVector& Max,
+		const TArray<TEnumAsByte<EObjectTypeQuery>>& ObjectTypes) const;
+	void TickGeneration();
+	void TraceWithinBudget(FGenerationJob& Job);
+	void SubmitAsyncTraces(FGenerationJob& Job);
+	void OnAsyncTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum, uint32 JobSerial);
+	void FinishGeneration();
+	// Stores generated cloud to the cache, compressed when bCompressClouds is set, in CloudLayout otherwise
+	void CommitCloud(FPointCloud Cloud, const FString& GenerationKey);
+
+	TOptional<FGenerationJob> GenerationJob;
+	// Async traces of cancelled jobs are ignored by serial
+	uint32 GenerationSerial = 0;
+
 	TSoftObjectPtr<UCloudCache> Cache;
 	FName CloudCacheTag;
+
+	// Created on first DrawSliceContours
+	UPROPERTY(Transient)
+	TObjectPtr<ULineBatchComponent> ContourLineBatch;
 };
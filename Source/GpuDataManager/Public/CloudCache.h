@@ -5,9 +5,43 @@
 #include "CoreMinimal.h"
 #include "UObject/Object.h"
 #include "SliceRelatedTypes.h"
+#include "SliceRequestTrace.h"
 #include "CloudCache.generated.h"
 
+// Slice stored by tag was replaced or removed
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnCloudCacheSliceChanged, FName /*CloudTag*/, FName /*SliceTag*/);
+
 #define NOT_IMPLEMENTED UE_LOG(LogTemp, Warning, TEXT("NotImplementedFunction() is not implemented!")); ensure(false)
+
+USTRUCT(BlueprintType)
+struct FCloudCacheStats
+{
+	GENERATED_BODY()
+
+	// Payload bytes held in RAM
+	UPROPERTY(BlueprintReadOnly)
+	int64 ResidentBytes = 0;
+
+	// Compressed payload bytes held in the spill directory
+	UPROPERTY(BlueprintReadOnly)
+	int64 SpilledBytes = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 ResidentBlobs = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 SpilledBlobs = 0;
+
+	// Number of payloads read back from the spill directory
+	UPROPERTY(BlueprintReadOnly)
+	int32 FaultCount = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	float AverageFaultLatencyMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float MaxFaultLatencyMs = 0.f;
+};
 /**
  * 
  */
@@ -26,11 +60,42 @@ public:
 		meta=(ToolTip="Update CloudPack data if necessary"))
 	void Load();
 
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Save CloudPack in binary form"))
+	bool SaveBinary(const FString &FileName) const;
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Replace CloudPack by content of binary file; the file is read through a mapping when the platform allows it, blobs are still copied into the pack"))
+	bool LoadBinary(const FString &FileName);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Load cache baked by the CloudCacheBake commandlet and shipped with the game"))
+	bool LoadBaked();
+
+	static FString GetBakedFileName();
+
 	// Work with clouds
 	UFUNCTION(BlueprintCallable,
 		meta=(ToolTip="Save Cloud value on RAM by CloudTag; to update cloud value just provide existed tag"))
 	void SetCloudValue(const FName &CloudTag, FPointCloud Cloud);
 
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Save Cloud value with the generation key it was produced with; slices of the tag are dropped when the key changes"))
+	void SetCloudValueWithKey(const FName &CloudTag, FPointCloud Cloud, const FString &GenerationKey);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Save run-length encoded cloud with its generation key in place of the plain cloud of the tag, GetCloud decodes it"))
+	void SetCompressedCloudValueWithKey(const FName &CloudTag, FRlePointCloud Cloud, const FString &GenerationKey);
+
+	// Compressed cloud without copy, valid until the cache is modified; null when the tag holds a plain cloud
+	const FRlePointCloud* FindCompressedCloud(const FName &CloudTag);
+	// Whether the tag holds a compressed cloud, not counted as a cache lookup
+	bool HasCompressedCloud(const FName &CloudTag) const;
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Get generation key of the cloud stored by tag, Success is false when no cloud is stored"))
+	FString GetCloudGenerationKey(const FName &CloudTag, bool &Success) const;
+
 	UFUNCTION(BlueprintCallable,
 		meta=(ToolTip="Get pair<cloudValue, slicePack> by tag"))
 	FCloud GetCloudWithSlices(const FName &CloudTag, bool &Success);
@@ -39,6 +104,20 @@ public:
 		meta=(ToolTip="Get cloud value by tag"))
 	FPointCloud GetCloud(const FName &CloudTag, bool &Success );
 
+	// Plain cloud without copy, valid until the cache is modified; null when the tag holds a compressed cloud
+	const FPointCloud* FindCloud(const FName &CloudTag);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Save labeled cloud by CloudTag next to the plain cloud of the tag"))
+	void SetLabeledCloud(const FName &CloudTag, FLabeledPointCloud Cloud);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Get labeled cloud by tag"))
+	FLabeledPointCloud GetLabeledCloud(const FName &CloudTag, bool &Success);
+
+	// Labeled cloud without copy, valid until the cache is modified; null when there is no such cloud
+	const FLabeledPointCloud* FindLabeledCloud(const FName &CloudTag);
+
 	UFUNCTION(BlueprintCallable,
 		meta=(ToolTip="Set slice by its tag and tag of the cloud slice was produced from"))
 	void SetSlice(const FName &CloudTag, const FName &SliceTag, FSlice Slice);
@@ -47,10 +126,164 @@ public:
 		meta=(ToolTip="Get slice by its tag and tag of the cloud slice was produced from"))
 	FSlice GetSlice(const FName &CloudTag, const FName &SliceTag, bool &Success);
 
+	// Slice without copy, valid until the cache is modified; null when there is no such slice
+	const FSlice* FindSlice(const FName &CloudTag, const FName &SliceTag);
+
+	FOnCloudCacheSliceChanged OnSliceChanged;
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Set contours extracted from the slice stored by the same tags, they are dropped when the slice changes"))
+	void SetSliceContours(const FName &CloudTag, const FName &SliceTag, FSliceContours Contours);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Get contours of the slice by its tag and tag of the cloud slice was produced from"))
+	FSliceContours GetSliceContours(const FName &CloudTag, const FName &SliceTag, bool &Success);
+
+	// Contours without copy, valid until the cache is modified; null when there are no such contours
+	const FSliceContours* FindSliceContours(const FName &CloudTag, const FName &SliceTag);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Append slice to the delta-compressed stack by its tag, fails if slice size differs from the stack; the stack is built in place and stored by FinalizeSliceStack"))
+	bool AppendToSliceStack(const FName &CloudTag, const FName &StackTag, const FSlice &Slice);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Hash and store the stack built by AppendToSliceStack, call once when the sweep is complete"))
+	void FinalizeSliceStack(const FName &CloudTag, const FName &StackTag);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Set whole delta-compressed slice stack by its tag"))
+	void SetSliceStack(const FName &CloudTag, const FName &StackTag, FSliceStack Stack);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Decode slice Index of the stack, starting from the nearest keyframe"))
+	FSlice GetSliceFromStack(const FName &CloudTag, const FName &StackTag, int32 Index, bool &Success);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Number of slices in the stack, 0 if there is no such stack"))
+	int32 GetSliceStackNum(const FName &CloudTag, const FName &StackTag);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Remove cloud tag with all its slices; shared payloads are freed when no tag references them"))
+	bool RemoveCloud(const FName &CloudTag);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Remove slice tag; shared payload is freed when no tag references it"))
+	bool RemoveSlice(const FName &CloudTag, const FName &SliceTag);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Number of distinct cloud payloads stored after deduplication"))
+	int32 GetUniqueCloudCount() const;
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Number of distinct slice payloads stored after deduplication"))
+	int32 GetUniqueSliceCount() const;
+
+	// Memory budget
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Limit RAM used by payloads, least recently used ones are spilled to disk; 0 disables the limit"))
+	void SetRamBudget(int64 NewRamBudgetBytes);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Resident/spilled bytes and spill fault latency"))
+	FCloudCacheStats GetStats() const;
+
+	// Request recording
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Record lookups of this cache and CalculateOrLoadSliceOnPlane of slicers using it, restarts a running recording"))
+	void StartRecording();
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Stop recording and write the trace for the CloudCacheReplay commandlet, false if recording is not started or the file can't be written"))
+	bool StopRecording(const FString &FileName);
+
+	UFUNCTION(BlueprintCallable)
+	bool IsRecording() const;
+
+	// Null when not recording
+	FSliceRequestRecorder* GetRecorder() const;
+
 	UFUNCTION(BlueprintCallable)
 	void FillByTestData();
-	
+
+	virtual void BeginDestroy() override;
+
+	// Payload bytes allowed in RAM, 0 means unlimited
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	int64 RamBudgetBytes = 0;
+
+	// Directory for spilled payloads, Saved/CloudCacheSpill when empty
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	FString SpillDirectory {};
+
 private:
+	struct FBlobResidency
+	{
+		int64 Bytes = 0;
+		uint64 LastAccess = 0;
+	};
+
+	struct FSpilledBlob
+	{
+		FString FileName;
+		int64 RawBytes = 0;
+		int64 DiskBytes = 0;
+	};
+
+	// Book-keeping for one kind of payload, not persisted
+	struct FBlobTier
+	{
+		// Number of tags referencing each payload
+		TMap<FString, int32> RefCounts;
+		TMap<FString, FBlobResidency> Resident;
+		TMap<FString, FSpilledBlob> Spilled;
+	};
+
+	template <typename T>
+	FString AddBlob(TMap<FString, T> &Blobs, FBlobTier &Tier, T Value);
+	template <typename T>
+	void ReleaseBlob(TMap<FString, T> &Blobs, FBlobTier &Tier, const FString &Hash);
+	// Returns resident payload, faulting it back from disk if it was spilled
+	template <typename T>
+	T* FindBlob(TMap<FString, T> &Blobs, FBlobTier &Tier, const FString &Hash);
+	template <typename T>
+	bool SpillBlob(TMap<FString, T> &Blobs, FBlobTier &Tier, const FString &Hash);
+	template <typename T>
+	bool ReadSpilledBlob(const FBlobTier &Tier, const FString &Hash, T &Out) const;
+
+	// CloudPack including spilled payloads, Storage keeps the copy alive when one is needed
+	const FCloudPack& GetFullPack(TOptional<FCloudPack> &Storage) const;
+
+	void TouchBlob(FBlobTier &Tier, const FString &Hash, int64 Bytes);
+	void EnforceRamBudget(const FString &PinnedHash = {});
+	void ReleaseSlices(const FName &CloudTag, FCloudRefs &Refs);
+	void ReleaseClouds(FCloudRefs &Refs);
+	void ReleaseSliceContours(FCloudRefs &Refs, const FName &SliceTag);
+	// Open stack of the tag if there is one, stored stack otherwise
+	const FSliceStack* FindSliceStack(const FName &CloudTag, const FName &StackTag);
+	void ResetTiers();
+	void RebuildRefCounts();
+	FString GetSpillDirectory() const;
+
 	// RAM storage
 	FCloudPack CloudPack {};
+
+	FBlobTier CloudTier {};
+	FBlobTier SliceTier {};
+	FBlobTier SliceStackTier {};
+	FBlobTier LabeledCloudTier {};
+	FBlobTier CompressedCloudTier {};
+	FBlobTier SliceContourTier {};
+
+	// Stacks being built by AppendToSliceStack, outside of the tiers so appends neither copy nor rehash
+	// the stack; they are not counted in the RAM budget until finalized
+	TMap<FName, TMap<FName, FSliceStack>> OpenSliceStacks;
+
+	int64 ResidentBytes = 0;
+	uint64 AccessCounter = 0;
+	int32 FaultCount = 0;
+	double TotalFaultSeconds = 0.0;
+	double MaxFaultSeconds = 0.0;
+	FGuid SpillGuid = FGuid::NewGuid();
+
+	TUniquePtr<FSliceRequestRecorder> Recorder;
 };
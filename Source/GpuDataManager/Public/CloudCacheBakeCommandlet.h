@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CloudCacheBakeCommandlet.generated.h"
+
+/*
+ * @USAGE
+ *
+ * UnrealEditor-Cmd MindBlock.uproject -run=CloudCacheBake [-Maps=/Game/A+/Game/B] [-Output=Path] -nullrhi
+ * Opens maps headlessly (all project maps by default), bakes every UActorSlicer with BakeSettings.bBake
+ * and writes binary cache to UCloudCache::GetBakedFileName, runtime loads it with UCloudCache::LoadBaked
+ * 
+ */
+UCLASS()
+class GPUDATAMANAGER_API UCloudCacheBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCloudCacheBakeCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
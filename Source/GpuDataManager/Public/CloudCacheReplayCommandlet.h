@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CloudCacheReplayCommandlet.generated.h"
+
+/*
+ * @USAGE
+ *
+ * UnrealEditor-Cmd MindBlock.uproject -run=CloudCacheReplay -Trace=File -nullrhi [-Cache=File] [-RamBudget=Bytes]
+ *     [-Output=File]
+ * Loads Cache (the baked cache by default) and re-runs every request of a trace recorded with
+ * UCloudCache::StartRecording as fast as possible; slice misses of CalculateOrLoadSlice are calculated and stored
+ * like at runtime. Logs latency percentiles and hit rates per request kind next to the recorded ones
+ * and writes them as JSON to Output when it is given
+ * 
+ */
+UCLASS()
+class GPUDATAMANAGER_API UCloudCacheReplayCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCloudCacheReplayCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/CanvasRenderTarget2D.h"
+#include "GenericDataArray.h"
+#include "DataManager.h"
+#include "DataAtlasManager.generated.h"
+
+USTRUCT(BlueprintType)
+struct FDataAtlasTile
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 Index = INDEX_NONE;
+
+	// Atlas UV = UVOffset + tile UV * UVScale
+	UPROPERTY(BlueprintReadOnly)
+	FVector2D UVOffset = FVector2D::ZeroVector;
+
+	UPROPERTY(BlueprintReadOnly)
+	FVector2D UVScale = FVector2D::UnitVector;
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+};
+
+/*
+ * @USAGE
+ *
+ * One render target split into TilesPerSide x TilesPerSide tiles of TileSize texels, each tile holds one float array
+ * Call Init, AcquireTile for every viewer and CreateTileMaterial (or set TileUVParameterName on own material)
+ * Tiles written through SetTileFloatArray/GetTileArray are uploaded together once per frame in Tick
+ * 
+ */
+UCLASS(Blueprintable)
+class GPUDATAMANAGER_API ADataAtlasManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ADataAtlasManager();
+
+	// Settings
+	UPROPERTY(BlueprintReadOnly, EditAnywhere)
+	UMaterialInstance* BaseMaterial {};
+
+	UPROPERTY(BlueprintReadOnly, EditAnywhere)
+	TSubclassOf<UCanvasRenderTarget2D> RenderTargetHandler;
+
+	UPROPERTY(BlueprintReadOnly, EditAnywhere)
+	FName TextureParameterName = "Texture";
+
+	// Vector parameter receiving (UVOffset.X, UVOffset.Y, UVScale.X, UVScale.Y) of the tile
+	UPROPERTY(BlueprintReadOnly, EditAnywhere)
+	FName TileUVParameterName = "TileUV";
+
+	UPROPERTY(BlueprintReadOnly, EditAnywhere)
+	int32 TileSize = 64;
+
+	UPROPERTY(BlueprintReadOnly, EditAnywhere)
+	int32 TilesPerSide = 8;
+
+	// Handler
+	UFUNCTION()
+	void OnCanvasRenderTargetUpdate(UCanvas* Canvas, int32 Width, int32 Height);
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	// Methods
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Create atlas render target, must be called before tiles are used"))
+	bool Init();
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Take a free tile, returned tile is invalid (Index = -1) when atlas is full"))
+	FDataAtlasTile AcquireTile();
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Return tile to the atlas, its content is cleared on the next upload"))
+	void ReleaseTile(const FDataAtlasTile& Tile);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Create material instance sampling the tile from the atlas render target"))
+	UMaterialInstanceDynamic* CreateTileMaterial(const FDataAtlasTile& Tile);
+
+	UFUNCTION(BlueprintCallable)
+	bool SetTileFloatArray(const FDataAtlasTile& Tile, const TArray<float>& Array);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Upload all dirty tiles now instead of waiting for the next tick"))
+	void Flush();
+
+	UPROPERTY(BlueprintAssignable,
+		meta=(ToolTip="Subscribe to this to handle render target update"))
+	FOnUpdate OnUpdate;
+
+	UFUNCTION(BlueprintCallable)
+	UCanvasRenderTarget2D* GetRenderTarget() const { return RenderTarget; }
+
+	// Null for tiles that weren't acquired
+	TGenericDataArray<float>* GetTileArray(const FDataAtlasTile& Tile);
+
+private:
+	bool IsAcquired(const FDataAtlasTile& Tile) const;
+	FIntPoint GetTileOrigin(int32 Index) const;
+
+	UPROPERTY()
+	UCanvasRenderTarget2D *RenderTarget {};
+
+	UPROPERTY()
+	UTexture2D *StagingTexture {};
+	FDataTextureUploadRing UploadRing;
+
+	TArray<TUniquePtr<TGenericDataArray<float>>> Tiles;
+	TBitArray<> AcquiredTiles;
+};
@@ -5,10 +5,59 @@
 #include "CoreMinimal.h"
 #include "Engine/CanvasRenderTarget2D.h"
 #include "GenericDataArray.h"
+#include "BufferedDataArray.h"
+#include "DataTextureUploader.h"
+#include "SliceRelatedTypes.h"
 #include "DataManager.generated.h"
 
+class UCloudCache;
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnUpdate, UCanvas*, Canvas, int32, Width, int32, Height);
 
+UENUM(BlueprintType)
+enum class ESliceResampleFilter : uint8
+{
+	// Average of the covered slice pixels, nearest when upscaling
+	Box,
+	Bilinear
+};
+
+// Colorizes float sources on upload: window/level, then gamma, then colormap lookup
+USTRUCT(BlueprintType)
+struct GPUDATAMANAGER_API FDataTransferFunction
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bEnabled = false;
+
+	// Value mapped to the middle of the colormap
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float WindowLevel = 0.5f;
+
+	// Value range mapped onto the whole colormap, values outside are clamped
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float WindowWidth = 1.f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float Gamma = 1.f;
+
+	// Evenly spaced colormap stops resampled to 256 entries, grayscale when empty
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	TArray<FLinearColor> Colormap;
+
+	// 256-entry lookup table with gamma applied
+	void BakeLut(TArray<FColor>& OutLut) const;
+	// Scale and bias mapping a value to its lookup table index
+	void GetIndexTransform(float& OutScale, float& OutBias) const;
+
+	bool operator==(const FDataTransferFunction& Other) const
+	{
+		return bEnabled == Other.bEnabled && WindowLevel == Other.WindowLevel && WindowWidth == Other.WindowWidth &&
+			Gamma == Other.Gamma && Colormap == Other.Colormap;
+	}
+};
+
 UCLASS(Blueprintable)
 class GPUDATAMANAGER_API ADataManager : public AActor
 {
@@ -30,6 +79,18 @@ public:
 	UPROPERTY(BlueprintReadOnly, EditAnywhere)
 	int32 TextureSize = 64;
 
+	// Upload active array into a transient texture with one region copy and draw it as a single tile;
+	// when disabled (or the texture can't be created) every element is drawn as its own canvas tile
+	UPROPERTY(BlueprintReadOnly, EditAnywhere)
+	bool bUseBulkUpload = true;
+
+	// Applied to Float, FloatR8 and FloatR16F sources, which are then uploaded as BGRA8; changes are picked up on the next update
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	FDataTransferFunction TransferFunction;
+
+	// Returns render target and material to the world pool
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	// Handler
 	UFUNCTION()
 	void OnCanvasRenderTargetUpdate(UCanvas* Canvas, int32 Width, int32 Height);
@@ -51,10 +112,37 @@ public:
 		meta=(ToolTip="Set FVector2d array as active source and call update function"))
 	void UpdateAsFVector3fArray();
 
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Set float array as active source quantized to 8 bit ([0, 1] range) and call update function"))
+	void UpdateAsFloatArrayR8();
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Set float array as active source converted to half floats and call update function"))
+	void UpdateAsFloatArrayR16F();
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Set channel arrays as active source packed into RGBA 8 bit ([0, 1] range) and call update function"))
+	void UpdateAsPackedChannels();
+
 	UFUNCTION(BlueprintCallable,
 		meta=(ToolTip="Call update function without any array transfer"))
 	void UpdateWithNoSource();
 
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Upload slice into float array, resampled to TextureSize when sizes differ, and call update function"))
+	bool SetSlice(const FSlice& Slice, ESliceResampleFilter Filter = ESliceResampleFilter::Bilinear);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Show slice stored in the cache and upload it again whenever the cache replaces it"))
+	bool BindSlice(UCloudCache* Cache, FName CloudTag, FName SliceTag, ESliceResampleFilter Filter = ESliceResampleFilter::Bilinear);
+
+	UFUNCTION(BlueprintCallable)
+	void UnbindSlice();
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Call update function if a producer thread published a new buffered array since the last update"))
+	bool UpdateIfPublished();
+
 	UPROPERTY(BlueprintAssignable,
 		meta=(ToolTip="Subscribe to this to handle render target update"))
 	FOnUpdate OnUpdate;
@@ -65,9 +153,44 @@ public:
 
 	// Export modifiers methods
 	UFUNCTION(BlueprintCallable)
-	void SetFloatArray(const TArray<float> Array)
+	void SetFloatArray(const TArray<float>& Array)
+	{
+		GetOrCreateFloatArray()->SetArray(Array);
+	}
+
+	// Channel is 0..3 for R, G, B, A of the packed RGBA8 source
+	UFUNCTION(BlueprintCallable)
+	bool SetChannelArray(int32 Channel, const TArray<float>& Array)
 	{
-		GetOrCreateFloatArray()->SetArray(std::move(Array));
+		TGenericDataArray<float>* ChannelArray = GetOrCreateChannelArray(Channel);
+		return ChannelArray && ChannelArray->SetArray(Array);
+	}
+
+	// Ingestion without per-update allocation: copy reuses the preallocated storage and writable view lets the caller
+	// fill it in place; move skips the copy only for arrays holding the full capacity, smaller ones are copied
+	bool MoveFloatArray(TArray<float>&& Array)
+	{
+		return GetOrCreateFloatArray()->SetArray(MoveTemp(Array));
+	}
+	bool CopyFloatArray(TConstArrayView<float> Array)
+	{
+		return GetOrCreateFloatArray()->SetArray(Array);
+	}
+	TArrayView<float> GetWritableFloatArray(int32 Num)
+	{
+		return GetOrCreateFloatArray()->GetWritableView(Num);
+	}
+	bool MoveFVector3fArray(TArray<FVector3f>&& Array)
+	{
+		return GetOrCreateFVector3fArray()->SetArray(MoveTemp(Array));
+	}
+	bool CopyFVector3fArray(TConstArrayView<FVector3f> Array)
+	{
+		return GetOrCreateFVector3fArray()->SetArray(Array);
+	}
+	TArrayView<FVector3f> GetWritableFVector3fArray(int32 Num)
+	{
+		return GetOrCreateFVector3fArray()->GetWritableView(Num);
 	}
 
 	// Utilities
@@ -83,26 +206,93 @@ public:
 	{
 		if (FloatDataArray == nullptr)
 		{
-			FloatDataArray = new TGenericDataArray<float>(TextureSize * TextureSize);
+			FloatDataArray = MakeUnique<TGenericDataArray<float>>(TextureSize * TextureSize, true, TextureSize);
 		}
-		return FloatDataArray;
+		return FloatDataArray.Get();
 	}
 	TGenericDataArray<FVector3f>* GetOrCreateFVector3fArray()
 	{
 		if (Vector3dDataArray == nullptr)
 		{
-			Vector3dDataArray = new TGenericDataArray<FVector3f>(TextureSize * TextureSize);
+			Vector3dDataArray = MakeUnique<TGenericDataArray<FVector3f>>(TextureSize * TextureSize, true, TextureSize);
+		}
+		return Vector3dDataArray.Get();
+	}
+
+	TGenericDataArray<float>* GetOrCreateChannelArray(int32 Channel)
+	{
+		if (Channel < 0 || Channel >= PackedChannelCount)
+		{
+			return nullptr;
 		}
-		return Vector3dDataArray;
+		if (ChannelDataArrays[Channel] == nullptr)
+		{
+			ChannelDataArrays[Channel] = MakeUnique<TGenericDataArray<float>>(TextureSize * TextureSize, true, TextureSize);
+		}
+		return ChannelDataArrays[Channel].Get();
+	}
+
+	// Buffered variants take precedence over the plain arrays once created, producers may run on any single thread
+	TBufferedDataArray<float>* GetOrCreateBufferedFloatArray()
+	{
+		if (BufferedFloatDataArray == nullptr)
+		{
+			BufferedFloatDataArray = MakeUnique<TBufferedDataArray<float>>(TextureSize * TextureSize, TextureSize);
+		}
+		return BufferedFloatDataArray.Get();
+	}
+	TBufferedDataArray<FVector3f>* GetOrCreateBufferedFVector3fArray()
+	{
+		if (BufferedVector3dDataArray == nullptr)
+		{
+			BufferedVector3dDataArray = MakeUnique<TBufferedDataArray<FVector3f>>(TextureSize * TextureSize, TextureSize);
+		}
+		return BufferedVector3dDataArray.Get();
 	}
 
 private:
+	// Array the render update reads, latest published buffer for buffered arrays
+	TGenericDataArray<float>* GetActiveFloatArray();
+	TGenericDataArray<FVector3f>* GetActiveFVector3fArray();
+
+	void ReleasePooledResources();
+
+	void OnBoundSliceChanged(FName CloudTag, FName SliceTag);
+	bool RefreshBoundSlice();
+
+	bool UploadActiveArray(UCanvas* Canvas, int32 Width, int32 Height);
+	// Rebakes the lookup table when TransferFunction was changed, returns true when it did; the caller marks
+	// the colorized sources dirty
+	bool RefreshTransferFunction();
+	void PackChannels(FDataTextureUpload& Upload, bool ForceFull);
+	void DrawActiveArrayTiles(UCanvas* Canvas);
+
 	UPROPERTY()
 	UCanvasRenderTarget2D *RenderTarget {};
 
-	// Data modifiers
-	TGenericDataArray<float>* FloatDataArray {};
-	TGenericDataArray<FVector3f>* Vector3dDataArray {};
+	// Bulk upload destination, recreated when the active array format changes
+	UPROPERTY()
+	UTexture2D *StagingTexture {};
+	// Staging buffers of StagingTexture updates, reused so steady-state updates don't allocate
+	FDataTextureUploadRing UploadRing;
+
+	// Data modifiers, owned by the actor
+	TUniquePtr<TGenericDataArray<float>> FloatDataArray;
+	TUniquePtr<TGenericDataArray<FVector3f>> Vector3dDataArray;
+	TUniquePtr<TBufferedDataArray<float>> BufferedFloatDataArray;
+	TUniquePtr<TBufferedDataArray<FVector3f>> BufferedVector3dDataArray;
+	static constexpr int32 PackedChannelCount = 4;
+	TUniquePtr<TGenericDataArray<float>> ChannelDataArrays[PackedChannelCount];
 
 	TOptional<EArrayTypes> CurrentActiveArrayType;
+
+	// Slice source
+	TWeakObjectPtr<UCloudCache> BoundCache;
+	FName BoundCloudTag;
+	FName BoundSliceTag;
+	ESliceResampleFilter BoundFilter = ESliceResampleFilter::Bilinear;
+	FDelegateHandle BoundSliceHandle;
+
+	FDataTransferFunction BakedTransferFunction;
+	TArray<FColor> TransferLut;
 };
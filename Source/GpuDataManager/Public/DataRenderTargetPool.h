@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/CanvasRenderTarget2D.h"
+#include "DataRenderTargetPool.generated.h"
+
+class UMaterialInstanceDynamic;
+
+USTRUCT(BlueprintType)
+struct FDataRenderTargetPoolStats
+{
+	GENERATED_BODY()
+
+	// Acquires served from the pool
+	UPROPERTY(BlueprintReadOnly)
+	int32 Hits = 0;
+
+	// Acquires that had to create a new object
+	UPROPERTY(BlueprintReadOnly)
+	int32 Misses = 0;
+
+	// Pooled objects dropped by the trim policy
+	UPROPERTY(BlueprintReadOnly)
+	int32 Trimmed = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 FreeRenderTargets = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 FreeMaterials = 0;
+};
+
+USTRUCT()
+struct FPooledDataRenderTarget
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	UCanvasRenderTarget2D* RenderTarget {};
+
+	UPROPERTY()
+	TSubclassOf<UCanvasRenderTarget2D> Class;
+
+	TEnumAsByte<ETextureRenderTargetFormat> Format = RTF_RGBA16f;
+	double ReleaseTime = 0;
+};
+
+USTRUCT()
+struct FPooledDataMaterial
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	UMaterialInstanceDynamic* Material {};
+
+	double ReleaseTime = 0;
+};
+
+/*
+ * @USAGE
+ *
+ * Per world pool of canvas render targets keyed by class, size and format and of dynamic material instances keyed by parent
+ * Acquired objects come with cleared update delegate / parameters, release them when the owner goes away
+ * Free objects idle for longer than MaxIdleSeconds or exceeding MaxFreePerKey are dropped
+ * 
+ */
+UCLASS()
+class GPUDATAMANAGER_API UDataRenderTargetPool : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UFUNCTION(BlueprintCallable)
+	UCanvasRenderTarget2D* AcquireRenderTarget(TSubclassOf<UCanvasRenderTarget2D> Class, int32 SizeX, int32 SizeY);
+
+	UFUNCTION(BlueprintCallable)
+	void ReleaseRenderTarget(UCanvasRenderTarget2D* RenderTarget);
+
+	UFUNCTION(BlueprintCallable)
+	UMaterialInstanceDynamic* AcquireMaterial(UMaterialInterface* Parent);
+
+	UFUNCTION(BlueprintCallable)
+	void ReleaseMaterial(UMaterialInstanceDynamic* Material);
+
+	UFUNCTION(BlueprintCallable,
+		meta=(ToolTip="Drop free objects idle for longer than MaxIdle seconds, 0 drops everything"))
+	void Trim(float MaxIdle);
+
+	UFUNCTION(BlueprintCallable)
+	FDataRenderTargetPoolStats GetStats() const;
+
+	// Trim policy
+	UPROPERTY(BlueprintReadWrite)
+	float MaxIdleSeconds = 30.f;
+
+	UPROPERTY(BlueprintReadWrite)
+	int32 MaxFreePerKey = 4;
+
+	// UTickableWorldSubsystem
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+private:
+	UPROPERTY()
+	TArray<FPooledDataRenderTarget> FreeRenderTargets;
+
+	UPROPERTY()
+	TArray<FPooledDataMaterial> FreeMaterials;
+
+	FDataRenderTargetPoolStats Stats;
+};
@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GpuDataBenchmarkCommandlet.generated.h"
+
+/*
+ * @USAGE
+ *
+ * UnrealEditor-Cmd MindBlock.uproject -run=GpuDataBenchmark -nullrhi [-Quick] [-Output=Dir] [-Baseline=File]
+ *     [-Tolerance=0.2] [-UpdateBaseline] [-RequireBaseline]
+ * Builds synthetic scenes (spheres, thin shells, many small boxes) in a transient world and times point cloud
+ * generation, slicing at several resolutions, linear vs brick cloud layout slicing at several plane orientations
+ * with simulated L1 misses per pixel, cache save/load at several pack sizes, upload kernels and data array updates
+ * with upload packing
+ * Writes Results.json and Results.csv to Output (Saved/Benchmarks/<time> by default) and compares throughput
+ * with Baseline (Benchmarks/GpuDataBaseline.json by default), returns 1 when any result is slower than Tolerance allows
+ * No baseline is committed, throughput depends on the machine: CI records one with -UpdateBaseline on its benchmark
+ * machine and passes it by -Baseline; results without baseline are reported with a warning, with -RequireBaseline
+ * they fail the run
+ *
+ * UnrealEditor-Cmd MindBlock.uproject -run=GpuDataBenchmark -nullrhi -CheckAllocations [-Quick]
+ * Runs only the data array update and upload packing steps repeatedly after a warm-up and returns 1 when any step
+ * changed the storage (data pointer or allocated size) of the array or of the upload buffers
+ * 
+ */
+UCLASS()
+class GPUDATAMANAGER_API UGpuDataBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UGpuDataBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Stats/Stats.h"
+#include "GpuDataManagerStats.generated.h"
+
+DECLARE_STATS_GROUP(TEXT("GpuDataManager"), STATGROUP_GpuDataManager, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate point cloud"), STAT_GpuData_GeneratePointCloud, STATGROUP_GpuDataManager, GPUDATAMANAGER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Calculate slice"), STAT_GpuData_CalculateSlice, STATGROUP_GpuDataManager, GPUDATAMANAGER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cache lookup"), STAT_GpuData_CacheLookup, STATGROUP_GpuDataManager, GPUDATAMANAGER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Serialization"), STAT_GpuData_Serialization, STATGROUP_GpuDataManager, GPUDATAMANAGER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Texture upload"), STAT_GpuData_TextureUpload, STATGROUP_GpuDataManager, GPUDATAMANAGER_API);
+
+// 64 bit counters, byte and trace counts pass 4G during bakes and loads of large packs
+DECLARE_QWORD_COUNTER_STAT_EXTERN(TEXT("Physics traces"), STAT_GpuData_PhysicsTraces, STATGROUP_GpuDataManager, GPUDATAMANAGER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Cache hits"), STAT_GpuData_CacheHits, STATGROUP_GpuDataManager, GPUDATAMANAGER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Cache misses"), STAT_GpuData_CacheMisses, STATGROUP_GpuDataManager, GPUDATAMANAGER_API);
+DECLARE_QWORD_COUNTER_STAT_EXTERN(TEXT("Bytes serialized"), STAT_GpuData_BytesSerialized, STATGROUP_GpuDataManager, GPUDATAMANAGER_API);
+DECLARE_QWORD_COUNTER_STAT_EXTERN(TEXT("Texture bytes uploaded"), STAT_GpuData_TextureBytesUploaded, STATGROUP_GpuDataManager, GPUDATAMANAGER_API);
+
+// Totals since start or the last reset, stat counters above show per frame values.
+// Times are exclusive: time of a nested scope, e.g. cache lookups while slicing, is not counted in the outer one
+USTRUCT(BlueprintType)
+struct FGpuDataManagerStatsSnapshot
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	int64 PhysicsTraces = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int64 CacheHits = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int64 CacheMisses = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int64 BytesSerialized = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int64 TextureBytesUploaded = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	float GenerationMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float SlicingMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float CacheLookupMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float SerializationMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float TextureUploadMs = 0.f;
+};
+
+enum class EGpuDataTimer : uint8
+{
+	Generation,
+	Slicing,
+	CacheLookup,
+	Serialization,
+	TextureUpload,
+	Num
+};
+
+// Thread-safe totals behind the snapshot, every Add also feeds the matching stat counter
+class GPUDATAMANAGER_API FGpuDataManagerStats
+{
+public:
+	static void AddPhysicsTraces(int64 Count);
+	static void AddCacheLookup(bool Hit);
+	static void AddBytesSerialized(int64 Bytes);
+	static void AddTextureBytesUploaded(int64 Bytes);
+	static void AddTime(EGpuDataTimer Timer, uint64 Cycles);
+
+	static FGpuDataManagerStatsSnapshot GetSnapshot();
+	static void Reset();
+
+	// Pauses the enclosing timer of the same thread while it runs
+	class GPUDATAMANAGER_API FScopedTimer
+	{
+	public:
+		explicit FScopedTimer(EGpuDataTimer InTimer);
+		~FScopedTimer();
+
+		UE_NONCOPYABLE(FScopedTimer);
+
+	private:
+		EGpuDataTimer Timer;
+		uint64 StartCycles;
+		FScopedTimer* Parent;
+	};
+};
+
+// Insights scope, stat cycle counter and snapshot time of one GpuDataManager operation;
+// Insights and stat cycle counters keep their inclusive hierarchy, only the snapshot time is exclusive
+#define GPUDATA_SCOPE(Stat, Timer) \
+	TRACE_CPUPROFILER_EVENT_SCOPE(Stat); \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	FGpuDataManagerStats::FScopedTimer PREPROCESSOR_JOIN(GpuDataScopedTimer, __LINE__)(EGpuDataTimer::Timer)
+
+UCLASS()
+class GPUDATAMANAGER_API UGpuDataManagerStatsLibrary : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+	UFUNCTION(BlueprintPure, Category="GpuDataManager",
+		meta=(ToolTip="Physics traces, cache hits/misses, serialized and uploaded bytes and operation times since start or the last reset"))
+	static FGpuDataManagerStatsSnapshot GetGpuDataManagerStats();
+
+	UFUNCTION(BlueprintCallable, Category="GpuDataManager")
+	static void ResetGpuDataManagerStats();
+};
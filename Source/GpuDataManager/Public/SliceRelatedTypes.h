@@ -3,19 +3,173 @@
 #include "CoreMinimal.h"
 #include "SliceRelatedTypes.generated.h"
 
+// Fixed-size part of FPointCloud points, only the last chunk of a cloud may be shorter
 USTRUCT(BlueprintType)
-struct FPointCloud
+struct FPointCloudChunk
 {
 	GENERATED_BODY()
 
 	UPROPERTY(BlueprintReadOnly)
 	TArray<bool> Points {};
 
+	bool operator==(const FPointCloudChunk &Other) const { return Points == Other.Points; }
+};
+
+UENUM(BlueprintType)
+enum class EPointCloudLayout : uint8
+{
+	// X fastest, then Y, then Z
+	Linear,
+	// 8x8x8 bricks in linear order, Morton order inside a brick; grid is padded to whole bricks.
+	// Every aligned 4x4x4 block is one 64 byte line, a 2x2x2 neighbourhood crossing a 4-aligned or brick
+	// boundary still spans up to 8 lines, but neighbouring pixels of any plane orientation reuse them.
+	// Axis-aligned slices along X are slightly worse than Linear; generation and run-length encoding stay linear
+	Bricks
+};
+
+// Points are stored in Layout order and split into chunks of ChunkSize points,
+// so grids over 2^31 points are addressable and no allocation grows with the grid
+USTRUCT(BlueprintType)
+struct FPointCloud
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	TArray<FPointCloudChunk> Chunks {};
+
 	UPROPERTY(BlueprintReadOnly)
 	FIntVector PointDensity { FIntVector::ZeroValue }; // Number of points
 
-	static int32 ToPlainIndex(const FIntVector &Coord, const FIntVector &MatrixSize);
+	UPROPERTY(BlueprintReadOnly)
+	EPointCloudLayout Layout = EPointCloudLayout::Linear;
+
+	static constexpr int32 ChunkShift = 24;
+	static constexpr int64 ChunkSize = 1ll << ChunkShift;
+	static constexpr int32 BrickShift = 3;
+
+	static int64 ToPlainIndex(const FIntVector &Coord, const FIntVector &MatrixSize);
+	static int64 ToBrickIndex(const FIntVector &Coord, const FIntVector &MatrixSize);
+	// Storage index of Coord in Layout
+	int64 ToIndex(const FIntVector &Coord) const;
 	bool IsValid(const FIntVector &Coord) const;
+	bool IsInside(const FIntVector &Coord) const { return GetPoint(ToIndex(Coord)); }
+
+	// Points stored so far, points PointDensity describes and points Layout stores for them
+	int64 Num() const { return Chunks.IsEmpty() ? 0 : (Chunks.Num() - 1) * ChunkSize + Chunks.Last().Points.Num(); }
+	int64 GetTotalPoints() const { return static_cast<int64>(PointDensity.X) * PointDensity.Y * PointDensity.Z; }
+	int64 GetStorageSize() const;
+
+	// Allocates all chunks for Density, every point is false
+	void Init(const FIntVector &Density, EPointCloudLayout InLayout = EPointCloudLayout::Linear);
+	// Appends the next point in plain index order to a Linear cloud, chunks are allocated as they fill
+	void Add(bool Value);
+	// Copy of the complete cloud with points reordered to NewLayout
+	FPointCloud ToLayout(EPointCloudLayout NewLayout) const;
+
+	bool GetPoint(int64 Index) const { return Chunks[static_cast<int32>(Index >> ChunkShift)].Points[static_cast<int32>(Index & (ChunkSize - 1))]; }
+	void SetPoint(int64 Index, bool Value) { Chunks[static_cast<int32>(Index >> ChunkShift)].Points[static_cast<int32>(Index & (ChunkSize - 1))] = Value; }
+	// Copies Count points to the points starting at Index, the range may cross chunks
+	void SetPoints(int64 Index, const bool *Values, int64 Count);
+
+	// xxHash64 over density and packed points, used as content address in UCloudCache
+	FString GetContentHash() const;
+	bool operator==(const FPointCloud &Other) const;
+
+	SIZE_T GetAllocatedSize() const;
+	friend FArchive& operator<<(FArchive &Ar, FPointCloud &Cloud);
+};
+
+// Cloud kept compressed in RAM, every X row is a sequence of alternating empty/inside run lengths
+// starting with empty; runs longer than uint16 allows are split by zero-length runs of the other value.
+// Empty rows have no runs, so a row costs its runs plus a 2 byte start and a 4 byte block offset per 2^RowBlockShift rows
+USTRUCT(BlueprintType)
+struct FRlePointCloud
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	FIntVector PointDensity { FIntVector::ZeroValue };
+
+	UPROPERTY()
+	TArray<uint16> Runs {};
+
+	// Runs of row Y + Z * PointDensity.Y start at BlockOffsets[Row >> RowBlockShift] + RowStarts[Row] and end
+	// where the next row starts
+	UPROPERTY()
+	TArray<int32> BlockOffsets {};
+
+	UPROPERTY()
+	TArray<uint16> RowStarts {};
+
+	// Picked by Reset so that runs of a block of rows always fit uint16 starts
+	UPROPERTY()
+	int32 RowBlockShift = 0;
+
+	static FRlePointCloud Encode(const FPointCloud &Cloud);
+	FPointCloud Decode() const;
+	// Writes PointDensity.X points of the row
+	void DecodeRow(int32 Y, int32 Z, bool *OutPoints) const;
+	bool IsInside(const FIntVector &Coord) const;
+
+	// Streaming encoder, points are appended in FPointCloud plain index order
+	void Reset(const FIntVector &Density);
+	void Append(bool Value);
+	// Drops the slack left by the encoder
+	void Shrink();
+
+	FString GetContentHash() const;
+	bool operator==(const FRlePointCloud &Other) const;
+
+	SIZE_T GetAllocatedSize() const { return Runs.GetAllocatedSize() + BlockOffsets.GetAllocatedSize() + RowStarts.GetAllocatedSize(); }
+	friend FArchive& operator<<(FArchive &Ar, FRlePointCloud &Cloud);
+
+private:
+	// Runs of Row are [OutBegin, OutEnd), false for rows not encoded yet
+	bool GetRowRuns(int32 Row, int32 &OutBegin, int32 &OutEnd) const;
+	// Runs.Num() where the row being encoded starts
+	int32 GetLastRowBegin() const { return BlockOffsets.Last() + RowStarts.Last(); }
+
+	// Encoder position inside the current row and value of the last run
+	int32 RowX = 0;
+	bool RunValue = false;
+};
+
+// Object a voxel of FLabeledPointCloud is inside of
+UENUM(BlueprintType)
+enum class EVoxelLabelSource : uint8
+{
+	Actor,
+	PhysicalMaterial
+};
+
+// Cloud of many objects generated in one pass, every point holds label of the object it is inside,
+// 0 is empty space; labels are in FPointCloud plain index order so equal labels form long runs along X.
+// Labels are a single array, so labeled grids are limited to MAX_int32 points
+USTRUCT(BlueprintType)
+struct FLabeledPointCloud
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<uint16> Labels {};
+
+	UPROPERTY(BlueprintReadOnly)
+	FIntVector PointDensity { FIntVector::ZeroValue };
+
+	// Actor or physical material name of label I + 1
+	UPROPERTY(BlueprintReadOnly)
+	TArray<FString> LabelNames {};
+
+	// 0 when there is no such label
+	uint16 FindLabel(const FString &LabelName) const;
+	// Points inside Label, inside any object for label 0
+	FPointCloud ToPointCloud(uint16 Label = 0) const;
+
+	FString GetContentHash() const;
+	bool operator==(const FLabeledPointCloud &Other) const;
+
+	SIZE_T GetAllocatedSize() const { return Labels.GetAllocatedSize() + LabelNames.GetAllocatedSize(); }
+	friend FArchive& operator<<(FArchive &Ar, FLabeledPointCloud &Cloud);
 };
 
 USTRUCT(BlueprintType)
@@ -34,6 +188,96 @@ struct FSlice
 
 	UPROPERTY(BlueprintReadOnly)
 	TArray<float> Data {};
+
+	// xxHash64 over size, resolution and pixel data, used as content address in UCloudCache
+	FString GetContentHash() const;
+	bool operator==(const FSlice &Other) const;
+
+	SIZE_T GetAllocatedSize() const { return Data.GetAllocatedSize(); }
+	friend FArchive& operator<<(FArchive &Ar, FSlice &Slice);
+};
+
+// Polyline in plane space: origin at the slice center, X along slice columns, Y along slice rows
+USTRUCT(BlueprintType)
+struct FSliceContour
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	TArray<FVector2D> Points {};
+
+	// Last point connects to the first one
+	UPROPERTY(BlueprintReadOnly)
+	bool bClosed = false;
+
+	bool operator==(const FSliceContour &Other) const { return bClosed == Other.bClosed && Points == Other.Points; }
+	friend FArchive& operator<<(FArchive &Ar, FSliceContour &Contour);
+};
+
+// Iso-lines of a slice extracted by marching squares, much smaller than the slice and sharp at any zoom
+USTRUCT(BlueprintType)
+struct FSliceContours
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	FVector2D PhysicalSize { FVector2D::ZeroVector };
+
+	// Slice values are 0..256 coverage, 128 is the object surface
+	UPROPERTY(BlueprintReadOnly)
+	float IsoValue = 128.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	TArray<FSliceContour> Contours {};
+
+	static FSliceContours Extract(const FSlice &Slice, float IsoValue = 128.f);
+
+	FString GetContentHash() const;
+	bool operator==(const FSliceContours &Other) const;
+
+	SIZE_T GetAllocatedSize() const;
+	friend FArchive& operator<<(FArchive &Ar, FSliceContours &Contours);
+};
+
+// Sweep of equally sized slices: keyframe slices every KeyframeInterval, others stored as
+// XOR delta against the previous slice; keyframes and deltas are zero-run-length encoded words
+USTRUCT(BlueprintType)
+struct FSliceStack
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	FVector2D PhysicalSize { FVector2D::ZeroVector };
+
+	UPROPERTY(BlueprintReadOnly)
+	FIntPoint Resolution { FIntPoint::ZeroValue };
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 KeyframeInterval = 16;
+
+	// Encoded slice I is Words[Offsets[I]..Offsets[I + 1])
+	UPROPERTY()
+	TArray<uint32> Words {};
+
+	UPROPERTY()
+	TArray<int32> Offsets {};
+
+	// Fails if Slice size differs from the slices already in the stack
+	bool Add(const FSlice &Slice);
+	bool GetSlice(int32 Index, FSlice &OutSlice) const;
+	int32 Num() const { return Offsets.Num(); }
+	// Release decoded last slice kept to speed up Add
+	void Shrink() { Tail.Empty(); }
+
+	FString GetContentHash() const;
+	bool operator==(const FSliceStack &Other) const;
+
+	SIZE_T GetAllocatedSize() const { return Words.GetAllocatedSize() + Offsets.GetAllocatedSize() + Tail.GetAllocatedSize(); }
+	friend FArchive& operator<<(FArchive &Ar, FSliceStack &Stack);
+
+private:
+	// Decoded last slice, base for the next delta; rebuilt lazily after load
+	TArray<uint32> Tail {};
 };
 
 USTRUCT(BlueprintType)
@@ -57,13 +301,66 @@ struct FCloud
 	FSlicePack SlicePack {};
 };
 
+// Content hashes a cloud tag points to; empty CloudHash means only slices were cached under the tag
+USTRUCT(BlueprintType)
+struct FCloudRefs
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	FString CloudHash {};
+
+	UPROPERTY(BlueprintReadOnly)
+	TMap<FName, FString> SliceHashes {};
+
+	UPROPERTY(BlueprintReadOnly)
+	TMap<FName, FString> SliceStackHashes {};
+
+	UPROPERTY(BlueprintReadOnly)
+	FString LabeledCloudHash {};
+
+	// Contours of slices by slice tag, dropped with the slice they were extracted from
+	UPROPERTY(BlueprintReadOnly)
+	TMap<FName, FString> SliceContourHashes {};
+
+	// Set instead of CloudHash when the cloud is kept run-length encoded
+	UPROPERTY(BlueprintReadOnly)
+	FString CompressedCloudHash {};
+
+	// Hash of generation parameters and scene state the cloud was produced with, see UActorSlicer::CalculateGenerationKey
+	UPROPERTY(BlueprintReadOnly)
+	FString GenerationKey {};
+
+	friend FArchive& operator<<(FArchive &Ar, FCloudRefs &Refs);
+};
+
 USTRUCT(BlueprintType)
 struct FCloudPack
 {
 	GENERATED_BODY()
 
+	// Tags -> content hashes
+	UPROPERTY(BlueprintReadOnly)
+	TMap<FName, FCloudRefs> Data {};
+
+	// Deduplicated payloads, shared by every tag with identical content
+	UPROPERTY(BlueprintReadOnly)
+	TMap<FString, FPointCloud> Clouds {};
+
+	UPROPERTY(BlueprintReadOnly)
+	TMap<FString, FSlice> Slices {};
+
+	UPROPERTY(BlueprintReadOnly)
+	TMap<FString, FSliceStack> SliceStacks {};
+
+	UPROPERTY(BlueprintReadOnly)
+	TMap<FString, FLabeledPointCloud> LabeledClouds {};
+
+	UPROPERTY(BlueprintReadOnly)
+	TMap<FString, FRlePointCloud> CompressedClouds {};
+
 	UPROPERTY(BlueprintReadOnly)
-	TMap<FName, FCloud> Data {};
+	TMap<FString, FSliceContours> SliceContours {};
 
 	TSharedPtr<FJsonObject> ToJsonObject(TOptional<FString> OutMessage) const;
 	static TOptional<FCloudPack> FromJsonObject(TSharedPtr<FJsonObject> Src);
@@ -73,4 +370,10 @@ struct FCloudPack
 
 	static void WriteToFile(const FString &Text, const FString &FileName = "FCloudPackDefault.txt");
 	static FString ReadFromFile(const FString &FileName = "FCloudPackDefault.txt");
+
+	// Binary form, used for the baked cache shipped with the game
+	friend FArchive& operator<<(FArchive &Ar, FCloudPack &Pack);
+	static bool WriteToBinaryFile(const FCloudPack &Pack, const FString &FileName);
+	// Deserializes every blob into owned arrays; mapping the file only avoids the intermediate read buffer
+	static TOptional<FCloudPack> ReadFromBinaryFile(const FString &FileName);
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+ * @USAGE
+ *
+ * Cache->StartRecording();
+ * ... play, every UCloudCache lookup and UActorSlicer::CalculateOrLoadSliceOnPlane on this cache is recorded ...
+ * Cache->StopRecording(FPaths::ProjectSavedDir() / TEXT("Traces/Playtest.slicetrace"));
+ *
+ * UnrealEditor-Cmd MindBlock.uproject -run=CloudCacheReplay -Trace=Playtest.slicetrace -Cache=Baked.cloudcache -nullrhi
+ *
+ */
+
+enum class ESliceRequestKind : uint8
+{
+	CalculateOrLoadSlice,
+	GetSlice,
+	FindSlice,
+	GetSliceFromStack,
+	GetCloud,
+	GetCloudWithSlices,
+	Num
+};
+
+GPUDATAMANAGER_API const TCHAR* LexToString(ESliceRequestKind Kind);
+
+struct FSliceRequestRecord
+{
+	ESliceRequestKind Kind = ESliceRequestKind::GetSlice;
+	// Seconds since recording start
+	double Timestamp = 0;
+	FName CloudTag {};
+	// Slice or stack tag
+	FName SliceTag {};
+	int32 StackIndex = 0;
+
+	// Plane of CalculateOrLoadSlice, stored in single precision
+	FVector3f PlaneOrigin = FVector3f::ZeroVector;
+	FRotator3f PlaneRotation = FRotator3f::ZeroRotator;
+	FVector3f PointCloudExtent = FVector3f::ZeroVector;
+	FRotator3f PointCloudRotation = FRotator3f::ZeroRotator;
+	FVector3f PointCloudOrigin = FVector3f::ZeroVector;
+	FVector2f ImagePhysicalSize = FVector2f::ZeroVector;
+	FIntPoint TargetImageSize = FIntPoint::ZeroValue;
+
+	// Outcome at recording time
+	bool Hit = false;
+	float LatencyMs = 0.f;
+};
+
+// Compact binary trace, tags are stored once in a name table
+struct GPUDATAMANAGER_API FSliceRequestTrace
+{
+	TArray<FSliceRequestRecord> Records;
+
+	bool WriteToFile(const FString& FileName) const;
+	static TOptional<FSliceRequestTrace> ReadFromFile(const FString& FileName);
+};
+
+// Game thread only, owned by UCloudCache while recording
+class GPUDATAMANAGER_API FSliceRequestRecorder
+{
+public:
+	FSliceRequestRecorder();
+
+	// Records the request when it is the outermost one, nested lookups are part of it
+	class GPUDATAMANAGER_API FScopedRequest
+	{
+	public:
+		FScopedRequest(FSliceRequestRecorder* InRecorder, ESliceRequestKind Kind);
+		~FScopedRequest();
+
+		UE_NONCOPYABLE(FScopedRequest);
+
+		bool IsRecording() const { return Recorder != nullptr; }
+
+		// Filled by the caller, Timestamp and LatencyMs are set on scope exit
+		FSliceRequestRecord Record;
+
+	private:
+		FSliceRequestRecorder* Recorder = nullptr;
+		FSliceRequestRecorder* NestedRecorder = nullptr;
+		double StartSeconds = 0;
+	};
+
+	const FSliceRequestTrace& GetTrace() const { return Trace; }
+
+private:
+	FSliceRequestTrace Trace;
+	double StartSeconds = 0;
+	int32 Depth = 0;
+};